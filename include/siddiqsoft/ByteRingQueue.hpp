@@ -0,0 +1,278 @@
+/*
+	Variable-length byte record ring queue
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef ByteRingQueue_HPP
+#define ByteRingQueue_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief ByteRingQueue. Single-producer single-consumer queue of variable-length byte records stored
+	 *        length-prefixed and contiguous in one preallocated ring. Producers write in place with
+	 *        reserve()/commit() and consumers read std::string_view's in place with peek()/release() so that
+	 *        string and message payloads do not cost an allocation per item.
+	 *        A record never wraps; when it does not fit at the end of the ring a skip marker is written and
+	 *        the record starts at offset zero.
+	 *        There must be at most one producer thread (reserve/commit/push) and one consumer thread
+	 *        (peek/release) at a time; the indices and the pending reservation are not protected against
+	 *        concurrent producers or consumers. Use WaitableQueue for multiple producers or consumers.
+	 */
+	class ByteRingQueue
+	{
+		using RecordHeader = uint32_t;
+
+		static constexpr RecordHeader SkipMarker      = UINT32_MAX;
+		static constexpr size_t       RecordAlignment = 8;
+		/// @brief Largest ring whose maxRecordSize() still fits the 32-bit record header
+		static constexpr uint64_t MaxCapacity = uint64_t {1} << 32;
+
+		static constexpr size_t recordSpan(size_t length)
+		{
+			return (sizeof(RecordHeader) + length + RecordAlignment - 1) & ~(RecordAlignment - 1);
+		}
+
+	public:
+		ByteRingQueue& operator=(const ByteRingQueue&) = delete;
+		ByteRingQueue(const ByteRingQueue&)            = delete;
+		ByteRingQueue(ByteRingQueue&&)                 = delete;
+		auto operator=(ByteRingQueue&&)                = delete;
+
+		/**
+		 * @brief Allocates the ring.
+		 *
+		 * @param capacityBytes Size of the ring; rounded up to a power of two (minimum 64 bytes)
+		 * @throws std::invalid_argument if capacityBytes exceeds 4GB (the record length header is 32 bits)
+		 */
+		explicit ByteRingQueue(size_t capacityBytes = 1024 * 1024)
+		{
+			if (capacityBytes > MaxCapacity)
+				throw std::invalid_argument(std::format("{} - Capacity of {} bytes exceeds the maximum {}", __func__, capacityBytes, MaxCapacity));
+
+			_capacity = 64;
+			while (_capacity < capacityBytes)
+				_capacity <<= 1;
+			_buffer = std::make_unique<char[]>(_capacity);
+		}
+
+		~ByteRingQueue() = default;
+
+		/// @brief Largest payload a single record may carry.
+		size_t maxRecordSize() const { return _capacity / 2 - sizeof(RecordHeader); }
+
+		/**
+		 * @brief Reserves space for a record of up to `length` bytes and returns it for in-place writing.
+		 *        Must be followed by commit() before the next reserve().
+		 *
+		 * @param length Maximum payload size the producer intends to write
+		 * @param timeoutDuration How long to wait for the consumer to free space
+		 * @return std::span<char> Writable payload area; empty on timeout
+		 * @throws std::length_error if length exceeds maxRecordSize()
+		 */
+		[[nodiscard]] std::span<char> reserve(size_t length, std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+		{
+			if (length > maxRecordSize())
+				throw std::length_error(std::format("{} - Record of {} bytes exceeds the maximum {}", __func__, length, maxRecordSize()));
+
+			auto tail       = _tail.load(std::memory_order_relaxed);
+			auto offset     = tail & (_capacity - 1);
+			auto contiguous = _capacity - offset;
+			auto needed     = recordSpan(length);
+			auto skip       = (needed > contiguous) ? contiguous : 0;
+
+			auto hasSpace = [&] { return (_capacity - (tail - _head.load(std::memory_order_seq_cst))) >= (skip + needed); };
+			if (!hasSpace() && !park(_producerWaiting, timeoutDuration, hasSpace)) return {};
+
+			if (skip)
+			{
+				std::memcpy(&_buffer[offset], &SkipMarker, sizeof(RecordHeader));
+				offset = 0;
+			}
+
+			_reservedSkip   = skip;
+			_reservedOffset = offset;
+			_reservedLength = length;
+			return {&_buffer[offset + sizeof(RecordHeader)], length};
+		}
+
+		/**
+		 * @brief Publishes the record written into the span returned by reserve().
+		 *
+		 * @param length Bytes actually written; must not exceed the reserved length
+		 */
+		void commit(size_t length)
+		{
+			if (length > _reservedLength) throw std::length_error(std::format("{} - Committed more than reserved", __func__));
+
+			auto header = static_cast<RecordHeader>(length);
+			std::memcpy(&_buffer[_reservedOffset], &header, sizeof(RecordHeader));
+			_tail.store(_tail.load(std::memory_order_relaxed) + _reservedSkip + recordSpan(length), std::memory_order_seq_cst);
+			_reservedLength = 0;
+			_counterAdds++;
+
+			if (_consumerWaiting.load(std::memory_order_seq_cst)) notify();
+		}
+
+		/// @brief Copies the payload into a new record.
+		/// @return false if space did not become available within the timeout
+		bool push(std::string_view value, std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+		{
+			auto area = reserve(value.size(), timeoutDuration);
+			if (area.data() == nullptr) return false;
+			std::memcpy(area.data(), value.data(), value.size());
+			commit(value.size());
+			return true;
+		}
+
+		/**
+		 * @brief Returns a view of the oldest record, waiting up to the specified interval for one to be committed.
+		 *        The view remains valid until release().
+		 *
+		 * @param timeoutDuration
+		 * @return std::optional<std::string_view>
+		 */
+		[[nodiscard]] auto peek(std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100)) -> std::optional<std::string_view>
+		{
+			auto head     = _head.load(std::memory_order_relaxed);
+			auto hasItems = [&] { return _tail.load(std::memory_order_seq_cst) != head; };
+			if (!hasItems() && !park(_consumerWaiting, timeoutDuration, hasItems)) return {};
+
+			auto         offset = head & (_capacity - 1);
+			RecordHeader header {0};
+			std::memcpy(&header, &_buffer[offset], sizeof(RecordHeader));
+			if (header == SkipMarker)
+			{
+				_peekSkip = _capacity - offset;
+				offset    = 0;
+				std::memcpy(&header, &_buffer[offset], sizeof(RecordHeader));
+			}
+			else
+			{
+				_peekSkip = 0;
+			}
+
+			_peekLength = header;
+			return std::string_view {&_buffer[offset + sizeof(RecordHeader)], header};
+		}
+
+		/// @brief Frees the record returned by the last successful peek().
+		void release()
+		{
+			_head.store(_head.load(std::memory_order_relaxed) + _peekSkip + recordSpan(_peekLength), std::memory_order_seq_cst);
+			_counterRemoves++;
+
+			if (_producerWaiting.load(std::memory_order_seq_cst)) notify();
+		}
+
+		/// @brief Returns the number of bytes in use, including record headers and padding.
+		size_t sizeBytes() const { return static_cast<size_t>(_tail.load() - _head.load()); }
+
+		/// @brief Returns the ring capacity in bytes.
+		size_t capacity() const { return _capacity; }
+
+		/// @brief Returns the number of records committed thus far.
+		auto addCounter() -> uint64_t { return _counterAdds; }
+
+		/// @brief Returns the number of records released thus far.
+		auto removeCounter() -> uint64_t { return _counterRemoves; }
+
+#ifdef INCLUDE_NLOHMANN_JSON_HPP_
+	public:
+		// If the JSON library is included in the current project, then make the serializer available.
+		nlohmann::json toJson()
+		{
+			return nlohmann::json {{"_typver", "ByteRingQueue/1.0.0"},
+			                       {"adds", _counterAdds.load()},
+			                       {"removes", _counterRemoves.load()},
+			                       {"capacity", _capacity},
+			                       {"sizeBytes", sizeBytes()}};
+		}
+#endif
+
+	private:
+		/// @brief Flags the caller as parked and sleeps until the predicate holds or the timeout elapses.
+		template <class Predicate>
+		bool park(std::atomic_bool& waiting, std::chrono::milliseconds timeoutDuration, Predicate&& ready)
+		{
+			std::unique_lock<std::mutex> lock(_parkMutex);
+			waiting.store(true, std::memory_order_seq_cst);
+			auto rc = _parkSignal.wait_for(lock, timeoutDuration, ready);
+			waiting.store(false, std::memory_order_relaxed);
+			return rc;
+		}
+
+		void notify()
+		{
+			// Taking the mutex orders the notify after a parked peer has evaluated its predicate
+			std::lock_guard<std::mutex> lock(_parkMutex);
+			_parkSignal.notify_all();
+		}
+
+	private:
+		size_t                  _capacity {0};
+		std::unique_ptr<char[]> _buffer {};
+		/// @brief Byte offset of the next record to write; owned by the producer
+		alignas(64) std::atomic_uint64_t _tail {0};
+		size_t _reservedOffset {0};
+		size_t _reservedSkip {0};
+		size_t _reservedLength {0};
+		std::atomic_uint64_t _counterAdds {0};
+		/// @brief Byte offset of the next record to read; owned by the consumer
+		alignas(64) std::atomic_uint64_t _head {0};
+		size_t                  _peekSkip {0};
+		size_t                  _peekLength {0};
+		std::atomic_uint64_t    _counterRemoves {0};
+		std::atomic_bool        _producerWaiting {false};
+		std::atomic_bool        _consumerWaiting {false};
+		std::mutex              _parkMutex {};
+		std::condition_variable _parkSignal {};
+	};
+} // namespace siddiqsoft
+
+#endif // !ByteRingQueue_HPP
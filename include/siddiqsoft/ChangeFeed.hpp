@@ -0,0 +1,219 @@
+/*
+	Bounded change feed for RWLContainer mutations
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#pragma once
+#ifndef ChangeFeed_HPP
+#define ChangeFeed_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+namespace siddiqsoft
+{
+	/// @brief The kind of mutation recorded in a ChangeFeed
+	enum class ChangeOp : uint8_t
+	{
+		Insert,
+		Replace,
+		Remove
+	};
+
+
+	/**
+	 * @brief A single mutation of an RWLContainer.
+	 *
+	 * @tparam KeyType
+	 * @tparam StorageType
+	 */
+	template <class KeyType, class StorageType>
+	struct ChangeRecord
+	{
+		/// @brief Position of the record in the feed; consecutive across all records
+		uint64_t version {0};
+		ChangeOp op {ChangeOp::Insert};
+		KeyType  key {};
+		/// @brief The new value for Insert and Replace; empty for Remove
+		std::shared_ptr<StorageType> value {};
+	};
+
+
+	/**
+	 * @brief ChangeFeed. Bounded log of the most recent mutations of a container which followers (caches, audit)
+	 *        read by cursor to stay in sync without rescanning the container.
+	 *        A single writer appends while holding the container's writer lock. Every slot of the ring carries the
+	 *        version of its record and its own tiny lock which is held only while that one record is assigned or
+	 *        copied, so the writer and the followers only meet when a follower copies the very slot being
+	 *        overwritten; there is no feed-wide lock. Polling an idle feed is a single atomic load.
+	 *        Once a follower falls more than capacity records behind, its cursor is overrun and it must resync.
+	 *
+	 * @tparam KeyType
+	 * @tparam StorageType
+	 */
+	template <class KeyType, class StorageType>
+	class ChangeFeed
+	{
+	public:
+		using Record = ChangeRecord<KeyType, StorageType>;
+
+	private:
+		struct Slot
+		{
+			/// @brief Held while the record is assigned or copied
+			mutable std::atomic_flag busy {};
+			Record                   record {};
+		};
+
+	public:
+
+		ChangeFeed& operator=(const ChangeFeed&) = delete;
+		ChangeFeed(const ChangeFeed&)            = delete;
+		ChangeFeed(ChangeFeed&&)                 = delete;
+		auto operator=(ChangeFeed&&)             = delete;
+
+		/**
+		 * @brief Allocates the ring.
+		 *
+		 * @param capacity Number of records retained; defaults to 4096
+		 */
+		explicit ChangeFeed(size_t capacity = 4096)
+			: _capacity(std::max<size_t>(capacity, 1))
+			, _slots(std::make_unique<Slot[]>(_capacity))
+		{
+		}
+
+		~ChangeFeed() = default;
+
+		/**
+		 * @brief Appends a record, overwriting the oldest once the ring is full. Must be invoked by a single writer.
+		 *
+		 * @return uint64_t The version of the record
+		 */
+		uint64_t append(ChangeOp op, const KeyType& key, const std::shared_ptr<StorageType>& value)
+		{
+			auto  version = _head.load(std::memory_order_relaxed);
+			auto& slot    = _slots[version % _capacity];
+
+			lock(slot);
+			slot.record.version = version;
+			slot.record.op      = op;
+			slot.record.key     = key;
+			slot.record.value   = value;
+			unlock(slot);
+			_head.store(version + 1, std::memory_order_release);
+
+			return version;
+		}
+
+		/**
+		 * @brief Copies up to maxRecords records starting at cursor and advances the cursor past them.
+		 *
+		 * @param cursor The version of the next record to read; start from head()
+		 * @param maxRecords Upper bound on the number of records returned
+		 * @return std::vector<Record> Empty when the follower is up to date
+		 * @throws std::out_of_range when the records at cursor were already overwritten, also while they were being
+		 *         copied; the follower must resync. The cursor is left unchanged.
+		 */
+		[[nodiscard]] auto read(uint64_t& cursor, size_t maxRecords = 256) const -> std::vector<Record>
+		{
+			std::vector<Record> records {};
+
+			// Fast path for followers which are up to date
+			auto head = _head.load(std::memory_order_acquire);
+			if (cursor == head) return records;
+
+			if (cursor > head) throw std::out_of_range(std::format("{} - cursor:{} is ahead of head:{}", __FUNCTION__, cursor, head));
+			if (head - cursor > _capacity)
+				throw std::out_of_range(std::format("{} - cursor:{} overrun; oldest available:{}", __FUNCTION__, cursor, head - _capacity));
+
+			auto count = std::min<uint64_t>(head - cursor, maxRecords);
+			records.reserve(count);
+			for (uint64_t i = 0; i < count; i++)
+			{
+				const auto& slot = _slots[(cursor + i) % _capacity];
+
+				lock(slot);
+				records.push_back(slot.record);
+				unlock(slot);
+
+				// The writer lapped us while we were copying
+				if (records.back().version != cursor + i)
+					throw std::out_of_range(std::format("{} - cursor:{} overrun; oldest available:{}", __FUNCTION__, cursor, tail()));
+			}
+			cursor += count;
+
+			return records;
+		}
+
+		/// @brief Returns the version the next record will receive; a new follower starts reading here.
+		uint64_t head() const { return _head.load(std::memory_order_acquire); }
+
+		/// @brief Returns the version of the oldest record still available.
+		uint64_t tail() const
+		{
+			auto head = _head.load(std::memory_order_acquire);
+			return head > _capacity ? head - _capacity : 0;
+		}
+
+		/// @brief Returns the number of records retained.
+		size_t capacity() const { return _capacity; }
+
+	private:
+		static void lock(const Slot& slot)
+		{
+			while (slot.busy.test_and_set(std::memory_order_acquire))
+				slot.busy.wait(true, std::memory_order_relaxed);
+		}
+
+		static void unlock(const Slot& slot)
+		{
+			slot.busy.clear(std::memory_order_release);
+			slot.busy.notify_one();
+		}
+
+	private:
+		size_t                  _capacity {1};
+		std::unique_ptr<Slot[]> _slots {};
+		std::atomic_uint64_t    _head {0};
+	};
+} // namespace siddiqsoft
+
+#endif // !ChangeFeed_HPP
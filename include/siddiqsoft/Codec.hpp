@@ -0,0 +1,147 @@
+/*
+	Serialization codecs for spill, snapshot and journal storage
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <concepts>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief A codec converts a StorageType into an opaque byte string and back.
+	 *        Used wherever we persist items outside of memory (spill files, snapshots, journals).
+	 *
+	 * @tparam C The codec type
+	 * @tparam T The type being encoded
+	 */
+	template <typename C, typename T>
+	concept Codec = requires(const C& codec, const T& value, std::string_view bytes) {
+		{ codec.encode(value) } -> std::convertible_to<std::string>;
+		{ codec.decode(bytes) } -> std::convertible_to<T>;
+	};
+
+
+	/**
+	 * @brief Codec for trivially copyable types; the bytes are the object representation.
+	 *        Not portable across architectures with differing endianness or padding.
+	 *
+	 * @tparam T Any trivially copyable type
+	 */
+	template <typename T>
+		requires std::is_trivially_copyable_v<T>
+	struct PodCodec
+	{
+		std::string encode(const T& value) const { return std::string(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+		T decode(std::string_view bytes) const
+		{
+			T value {};
+			std::memcpy(&value, bytes.data(), (bytes.size() < sizeof(T)) ? bytes.size() : sizeof(T));
+			return value;
+		}
+	};
+
+
+	/**
+	 * @brief Pass-through codec for std::string
+	 */
+	struct StringCodec
+	{
+		std::string encode(const std::string& value) const { return value; }
+		std::string decode(std::string_view bytes) const { return std::string(bytes); }
+	};
+
+
+	template <typename T>
+	struct DefaultCodecSelector
+	{
+		using type = void;
+	};
+
+	template <typename T>
+		requires std::is_trivially_copyable_v<T>
+	struct DefaultCodecSelector<T>
+	{
+		using type = PodCodec<T>;
+	};
+
+	template <>
+	struct DefaultCodecSelector<std::string>
+	{
+		using type = StringCodec;
+	};
+
+
+	/**
+	 * @brief Selects StringCodec for std::string and PodCodec for trivially copyable types.
+	 *        Any other type requires a user-supplied codec.
+	 */
+	template <typename T>
+	using DefaultCodec = typename DefaultCodecSelector<T>::type;
+
+
+	/**
+	 * @brief A codec whose output is JSON text; such codecs declare `static constexpr bool ProducesJson = true`.
+	 */
+	template <typename C>
+	concept JsonTextCodec = requires {
+		requires C::ProducesJson;
+	};
+
+
+#ifdef INCLUDE_NLOHMANN_JSON_HPP_
+	/**
+	 * @brief Codec producing JSON text via the nlohmann to_json/from_json of the type.
+	 *        Use it with ExportFormat::JsonLines.
+	 */
+	template <typename T>
+	struct JsonCodec
+	{
+		static constexpr bool ProducesJson = true;
+
+		std::string encode(const T& value) const { return nlohmann::json(value).dump(); }
+		T           decode(std::string_view bytes) const { return nlohmann::json::parse(bytes).template get<T>(); }
+	};
+#endif
+} // namespace siddiqsoft
+
+#endif // !CODEC_HPP
@@ -0,0 +1,174 @@
+/*
+	Columnar side index for predicate scans over RWLContainer values
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#pragma once
+#ifndef ColumnIndex_HPP
+#define ColumnIndex_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "siddiqsoft/SecondaryIndex.hpp"
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief ColumnIndex. Dense array of one numeric field projected from every value, with the keys and values in
+	 *        parallel arrays, so a predicate scan reads contiguous memory instead of dereferencing a shared_ptr per
+	 *        entry. The predicate is evaluated for a block of the column at a time in a branch-free loop which the
+	 *        compiler vectorizes for simple comparisons; only the matching entries are dereferenced.
+	 *        Removal moves the last slot into the hole so the column stays dense.
+	 *
+	 * @tparam KeyType
+	 * @tparam StorageType
+	 * @tparam ColumnValue Arithmetic type of the projected field
+	 */
+	template <class KeyType, class StorageType, class ColumnValue>
+		requires std::is_arithmetic_v<ColumnValue>
+	class ColumnIndex : public SecondaryIndexBase<KeyType, StorageType>
+	{
+	public:
+		using StorageTypePtr = std::shared_ptr<StorageType>;
+		using Projection     = std::function<ColumnValue(const StorageType&)>;
+
+		/// @brief Number of column values evaluated per pass of the predicate
+		static constexpr size_t BlockSize = 256;
+
+		ColumnIndex& operator=(const ColumnIndex&) = delete;
+		ColumnIndex(const ColumnIndex&)            = delete;
+
+		/**
+		 * @brief Creates an empty column.
+		 *
+		 * @param projection Extracts the field from a value
+		 */
+		explicit ColumnIndex(Projection projection)
+			: _projection(std::move(projection))
+		{
+		}
+
+		/// @brief Columns never reject a value
+		void check(const KeyType&, const StorageTypePtr&) const override { }
+		void checkBatch(const typename ColumnIndex::BatchVisitor&) const override { }
+
+		void insert(const KeyType& key, const StorageTypePtr& value) override
+		{
+			_slots.emplace(key, _values.size());
+			_values.push_back(_projection(*value));
+			_keys.push_back(key);
+			_items.push_back(value);
+		}
+
+		void erase(const KeyType& key, const StorageTypePtr&) override
+		{
+			auto slot = _slots.find(key);
+			if (slot == _slots.end()) return;
+
+			auto hole = slot->second;
+			auto last = _values.size() - 1;
+			_slots.erase(slot);
+			if (hole != last)
+			{
+				_values[hole]       = _values[last];
+				_keys[hole]         = std::move(_keys[last]);
+				_items[hole]        = std::move(_items[last]);
+				_slots[_keys[hole]] = hole;
+			}
+			_values.pop_back();
+			_keys.pop_back();
+			_items.pop_back();
+		}
+
+		/**
+		 * @brief Invokes callback(key, value) for every entry whose column value satisfies the predicate.
+		 *
+		 * @param predicate bool(ColumnValue); keep it a simple comparison so that it vectorizes
+		 * @param callback void(const KeyType&, const StorageTypePtr&)
+		 * @return size_t The number of matching entries
+		 */
+		template <class Predicate, class Callback>
+		size_t scanWhere(Predicate& predicate, Callback& callback) const
+		{
+			size_t  matches {0};
+			uint8_t selected[BlockSize];
+
+			for (size_t base = 0; base < _values.size(); base += BlockSize)
+			{
+				auto               count  = std::min(BlockSize, _values.size() - base);
+				const ColumnValue* values = _values.data() + base;
+				uint8_t            any {0};
+
+				for (size_t i = 0; i < count; i++)
+				{
+					selected[i] = static_cast<uint8_t>(predicate(values[i]));
+					any |= selected[i];
+				}
+				if (!any) continue;
+
+				for (size_t i = 0; i < count; i++)
+				{
+					if (selected[i])
+					{
+						callback(_keys[base + i], _items[base + i]);
+						matches++;
+					}
+				}
+			}
+
+			return matches;
+		}
+
+		/// @brief Returns the number of entries in the column
+		size_t size() const { return _values.size(); }
+
+	private:
+		Projection                          _projection;
+		std::vector<ColumnValue>            _values {};
+		std::vector<KeyType>                _keys {};
+		std::vector<StorageTypePtr>         _items {};
+		std::unordered_map<KeyType, size_t> _slots {};
+	};
+} // namespace siddiqsoft
+
+#endif // !ColumnIndex_HPP
@@ -0,0 +1,199 @@
+/*
+	Streaming export of container entries
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#pragma once
+#ifndef ExportWriter_HPP
+#define ExportWriter_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+
+namespace siddiqsoft
+{
+	/// @brief Output formats of ExportWriter
+	enum class ExportFormat
+	{
+		/// @brief One {"key":...,"value":...} object per line; the value codec must produce JSON text and the key is
+		/// either text (written as a JSON string) or JSON text; see ExportWriter::write and ExportWriter::writeJson
+		JsonLines,
+		/// @brief Records [u32 keyBytes][u32 valueBytes][key][value] in native byte order
+		Binary
+	};
+
+
+	/**
+	 * @brief ExportWriter. Formats encoded entries into a buffer which is handed to the sink in chunks of about
+	 *        chunkBytes so that memory use is bounded regardless of the number of entries.
+	 */
+	class ExportWriter
+	{
+	public:
+		using Sink = std::function<void(std::string_view)>;
+
+		ExportWriter(Sink sink, ExportFormat format, size_t chunkBytes = 64 * 1024)
+			: _sink(std::move(sink))
+			, _format(format)
+			, _chunkBytes(chunkBytes)
+		{
+			_buffer.reserve(_chunkBytes + 256);
+		}
+
+		ExportWriter& operator=(const ExportWriter&) = delete;
+		ExportWriter(const ExportWriter&)            = delete;
+
+		/// @brief Sink writing to a std::ostream
+		static Sink toStream(std::ostream& stream)
+		{
+			return [&stream](std::string_view chunk) {
+				if (!stream.write(chunk.data(), chunk.size()))
+					throw std::runtime_error(std::format("{} - Failed to write {} bytes", __FUNCTION__, chunk.size()));
+			};
+		}
+
+#if defined(__unix__) || defined(__APPLE__)
+		/// @brief Sink writing to a file descriptor (file, pipe or socket); the descriptor is not closed
+		static Sink toFd(int fd)
+		{
+			return [fd](std::string_view chunk) {
+				while (!chunk.empty())
+				{
+					auto rc = ::write(fd, chunk.data(), chunk.size());
+					if (rc < 0 && errno == EINTR) continue;
+					if (rc < 0) throw std::runtime_error(std::format("{} - Failed to write fd:{} errno:{}", __FUNCTION__, fd, errno));
+					chunk.remove_prefix(static_cast<size_t>(rc));
+				}
+			};
+		}
+#endif
+
+		/// @brief Appends an entry; hands the buffer to the sink once it reaches the chunk size.
+		/// For JsonLines the key is text which is written as a JSON string.
+		/// @throws std::length_error when a Binary key or value exceeds 4GB
+		void write(std::string_view key, std::string_view value) { append(key, value, false); }
+
+		/// @brief Appends an entry whose key is already JSON text (for example a number); same as write for Binary.
+		void writeJson(std::string_view key, std::string_view value) { append(key, value, true); }
+
+		/// @brief Hands any buffered entries to the sink.
+		void flush()
+		{
+			if (_buffer.empty()) return;
+			_sink(_buffer);
+			_buffer.clear();
+			_chunks++;
+		}
+
+		/// @brief Returns the number of entries written.
+		uint64_t entries() const { return _entries; }
+
+		/// @brief Returns the number of chunks handed to the sink.
+		uint64_t chunks() const { return _chunks; }
+
+	private:
+		void append(std::string_view key, std::string_view value, bool keyIsJson)
+		{
+			if (_format == ExportFormat::Binary)
+			{
+				constexpr size_t MaxBytes = std::numeric_limits<uint32_t>::max();
+				if ((key.size() > MaxBytes) || (value.size() > MaxBytes))
+					throw std::length_error(std::format("{} - Entry of {}+{} bytes exceeds the 4GB record limit", __FUNCTION__, key.size(), value.size()));
+
+				uint32_t lengths[2] {static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size())};
+				_buffer.append(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+				_buffer.append(key);
+				_buffer.append(value);
+			}
+			else
+			{
+				_buffer.append(R"({"key":)");
+				if (keyIsJson)
+					_buffer.append(key);
+				else
+					appendJsonString(key);
+				_buffer.append(R"(,"value":)");
+				_buffer.append(value);
+				_buffer.append("}\n");
+			}
+			_entries++;
+
+			if (_buffer.size() >= _chunkBytes) flush();
+		}
+
+		void appendJsonString(std::string_view text)
+		{
+			_buffer.push_back('"');
+			for (auto c : text)
+			{
+				switch (c)
+				{
+					case '"': _buffer.append("\\\""); break;
+					case '\\': _buffer.append("\\\\"); break;
+					case '\n': _buffer.append("\\n"); break;
+					case '\r': _buffer.append("\\r"); break;
+					case '\t': _buffer.append("\\t"); break;
+					default:
+						if (static_cast<unsigned char>(c) < 0x20)
+							_buffer.append(std::format("\\u{:04x}", static_cast<unsigned>(c)));
+						else
+							_buffer.push_back(c);
+				}
+			}
+			_buffer.push_back('"');
+		}
+
+	private:
+		Sink         _sink;
+		ExportFormat _format {ExportFormat::JsonLines};
+		size_t       _chunkBytes {64 * 1024};
+		std::string  _buffer {};
+		uint64_t     _entries {0};
+		uint64_t     _chunks {0};
+	};
+} // namespace siddiqsoft
+
+#endif // !ExportWriter_HPP
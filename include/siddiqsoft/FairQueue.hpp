@@ -0,0 +1,277 @@
+/*
+	Reader-Writer lock protected multi-tenant fair queue
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef FairQueue_HPP
+#define FairQueue_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <semaphore>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "siddiqsoft/WaitableQueue.hpp"
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief FairQueue. Tenant-aware WaitableQueue: each tenant has its own FIFO and consumers pull using
+	 *        deficit round robin so that one noisy tenant cannot starve the others.
+	 *        A tenant with weight N receives up to N items per round. Only tenants with queued items sit on
+	 *        the ready list so each dequeue is O(1) regardless of the number of tenants. A tenant whose queue
+	 *        empties is forgotten unless it was configured via setWeight, so short-lived tenant ids do not accumulate.
+	 *        Object cannot be re-assigned, copied or moved as it stores a shared_mutex and counting_semaphore.
+	 *
+	 * @tparam TenantType Hashable tenant identifier
+	 * @tparam StorageType Any moveable object
+	 * @tparam StorageContainer Per-tenant FIFO; defaults to a std::queue<StorageType>
+	 */
+	template <class TenantType, class StorageType, class StorageContainer = std::queue<StorageType>>
+		requires Movable<StorageType>
+	class FairQueue
+	{
+		using RWLock = std::unique_lock<std::shared_mutex>;
+		using RLock  = std::shared_lock<std::shared_mutex>;
+
+		struct Tenant
+		{
+			StorageContainer items {};
+			uint32_t         weight {1};
+			/// @brief Items the tenant may still take in the current round
+			uint32_t deficit {0};
+			bool     ready {false};
+			/// @brief Set by setWeight; configured tenants are kept while idle
+			bool     configured {false};
+			uint64_t counterAdds {0};
+			uint64_t counterRemoves {0};
+		};
+
+		using TenantMap = std::unordered_map<TenantType, Tenant>;
+
+	public:
+		FairQueue& operator=(const FairQueue&) = delete;
+		FairQueue(const FairQueue&)            = delete;
+		FairQueue(FairQueue&&)                 = delete;
+		auto operator=(FairQueue&&)            = delete;
+		FairQueue()                            = default;
+		~FairQueue()                           = default;
+
+		/// @brief Weight assigned to tenants which have not been configured with setWeight
+		uint32_t DefaultWeight {1};
+
+		/**
+		 * @brief Sets the number of items the tenant receives per round. Takes effect at the tenant's next round.
+		 *
+		 * @param tenant
+		 * @param weight Minimum of 1
+		 */
+		void setWeight(const TenantType& tenant, uint32_t weight)
+		{
+			RWLock _ {_containerMutex};
+
+			auto& entry      = findOrCreate(tenant).second;
+			entry.weight     = std::max<uint32_t>(weight, 1);
+			entry.configured = true;
+		}
+
+		/**
+		 * @brief Push item at the end of the tenant's queue and signals waiting clients.
+		 *
+		 * @param tenant
+		 * @param value The client must std::move() the item if they wish to transfer ownership.
+		 */
+		void push(const TenantType& tenant, StorageType&& value) { emplace(tenant, std::move(value)); }
+
+		/**
+		 * @brief Constructs the item in place at the end of the tenant's queue and signals waiting clients.
+		 *
+		 * @param tenant
+		 * @param args The arguments are forwarded to the constructor of StorageType
+		 */
+		template <class... Args>
+			requires std::constructible_from<StorageType, Args...>
+		void emplace(const TenantType& tenant, Args&&... args)
+		{
+			if (RWLock _ {_containerMutex}; true)
+			{
+				auto& node  = findOrCreate(tenant);
+				auto& entry = node.second;
+				entry.items.emplace(std::forward<Args>(args)...);
+				entry.counterAdds++;
+				_counterAdds++;
+				_size++;
+				if (!entry.ready)
+				{
+					entry.ready = true;
+					_ready.push_back(&node);
+				}
+			}
+			// Must be outside the lock!
+			_signal.release();
+		}
+
+		/**
+		 * @brief Returns the next item in deficit round robin order, waiting up to the specified interval for one.
+		 *
+		 * @param timeoutDuration
+		 * @return std::optional<StorageType>
+		 */
+		[[nodiscard]] auto tryWaitItem(std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+				-> std::optional<StorageType>
+		{
+			std::optional<StorageType> item {};
+
+			if (_signal.try_acquire_for(timeoutDuration))
+			{
+				if (RWLock _ {_containerMutex}; !_ready.empty())
+				{
+					auto* node  = _ready.front();
+					auto* entry = &node->second;
+					// A new round for this tenant
+					if (entry->deficit == 0) entry->deficit = entry->weight;
+
+					item.emplace(std::move(entry->items.front()));
+					entry->items.pop();
+					entry->deficit--;
+					entry->counterRemoves++;
+					_counterRemoves++;
+					_size--;
+
+					if (entry->items.empty())
+					{
+						// Idle tenants leave the ready list and forfeit the remaining quantum
+						entry->deficit = 0;
+						entry->ready   = false;
+						_ready.pop_front();
+						if (!entry->configured) _tenants.erase(node->first);
+					}
+					else if (entry->deficit == 0)
+					{
+						// Quantum spent; move to the back of the round
+						_ready.pop_front();
+						_ready.push_back(node);
+					}
+				}
+			}
+
+			return item;
+		}
+
+		/// @brief Returns the number of elements queued across all tenants.
+		auto size() -> size_t
+		{
+			RLock _ {_containerMutex};
+
+			return _size;
+		}
+
+		/// @brief Returns the number of elements queued for the tenant.
+		auto size(const TenantType& tenant) -> size_t
+		{
+			RLock _ {_containerMutex};
+
+			if (auto it = _tenants.find(tenant); it != _tenants.end()) return it->second.items.size();
+			return 0;
+		}
+
+		/// @brief Returns the number of tenants currently holding queued items.
+		auto activeTenants() -> size_t
+		{
+			RLock _ {_containerMutex};
+
+			return _ready.size();
+		}
+
+		/// @brief Returns the number of tenants tracked: those with queued items and those configured via setWeight.
+		auto tenantCount() -> size_t
+		{
+			RLock _ {_containerMutex};
+
+			return _tenants.size();
+		}
+
+		/// @brief Returns the number of elements added thus far.
+		auto addCounter() -> uint64_t { return _counterAdds; }
+
+		/// @brief Returns the number of times tryWaitItem resulted in a successful item retrieval.
+		auto removeCounter() -> uint64_t { return _counterRemoves; }
+
+#ifdef INCLUDE_NLOHMANN_JSON_HPP_
+	public:
+		// If the JSON library is included in the current project, then make the serializer available.
+		nlohmann::json toJson()
+		{
+			RLock _ {_containerMutex};
+
+			return nlohmann::json {{"_typver", "FairQueue/1.0.0"},
+			                       {"adds", _counterAdds},
+			                       {"removes", _counterRemoves},
+			                       {"tenants", _tenants.size()},
+			                       {"activeTenants", _ready.size()},
+			                       {"size", _size}};
+		}
+#endif
+
+	private:
+		/// @brief Must be invoked within the lock. The unordered_map keeps the address of each tenant stable.
+		typename TenantMap::value_type& findOrCreate(const TenantType& tenant)
+		{
+			auto [it, inserted] = _tenants.try_emplace(tenant);
+			if (inserted) it->second.weight = DefaultWeight;
+			return *it;
+		}
+
+	private:
+		/// @brief Semaphore with default max signals.
+		std::counting_semaphore<> _signal {0};
+		/// @brief Per-tenant state
+		TenantMap _tenants {};
+		/// @brief Tenants with queued items in round robin order; the map entries so that idle tenants can be erased
+		std::deque<typename TenantMap::value_type*> _ready {};
+		/// @brief The shared mutex used to perform reader-writer lock
+		mutable std::shared_mutex _containerMutex;
+		size_t                    _size {0};
+		uint64_t                  _counterAdds {0};
+		uint64_t                  _counterRemoves {0};
+	};
+} // namespace siddiqsoft
+
+#endif // !FairQueue_HPP
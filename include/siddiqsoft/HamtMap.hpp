@@ -0,0 +1,467 @@
+/*
+	Persistent hash array mapped trie
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#pragma once
+#ifndef HamtMap_HPP
+#define HamtMap_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief HamtMap. Persistent hash array mapped trie (CHAMP layout) with the subset of the std::unordered_map
+	 *        interface used by RWLContainer. Nodes are immutable and shared between copies: copying the map is O(1)
+	 *        and an update copies only the path to the changed entry, O(log32 n). Use it as the StorageContainer
+	 *        of an RWLContainer so that the copy-on-write after a snapshot() no longer copies the whole map.
+	 *        Iterators yield const entries since the entries are shared between versions.
+	 *
+	 * @tparam Key
+	 * @tparam T
+	 * @tparam Hash
+	 * @tparam KeyEqual
+	 */
+	template <class Key, class T, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+	class HamtMap
+	{
+	public:
+		using key_type    = Key;
+		using mapped_type = T;
+		using value_type  = std::pair<const Key, T>;
+		using size_type   = size_t;
+		using hasher      = Hash;
+		using key_equal   = KeyEqual;
+
+	private:
+		static constexpr unsigned BitsPerLevel = 5;
+		static constexpr unsigned HashBits     = sizeof(size_t) * 8;
+		/// @brief Bitmap levels plus the collision level
+		static constexpr unsigned MaxDepth = (HashBits + BitsPerLevel - 1) / BitsPerLevel + 1;
+
+		struct Node;
+		using NodePtr = std::shared_ptr<const Node>;
+
+		/// @brief Entries and sub-nodes are stored in bitmap order. Below the last bitmap level a node holds
+		///        the colliding entries unordered.
+		struct Node
+		{
+			uint32_t                dataMap {0};
+			uint32_t                nodeMap {0};
+			std::vector<value_type> entries {};
+			std::vector<NodePtr>    children {};
+
+			bool isSingleEntry() const { return (entries.size() == 1) && children.empty(); }
+		};
+
+	public:
+		/**
+		 * @brief Forward iterator over the entries of one version of the map.
+		 */
+		class const_iterator
+		{
+			friend class HamtMap;
+
+			struct Frame
+			{
+				const Node* node {nullptr};
+				uint32_t    entry {0};
+				uint32_t    child {0};
+			};
+
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type        = HamtMap::value_type;
+			using difference_type   = std::ptrdiff_t;
+			using pointer           = const value_type*;
+			using reference         = const value_type&;
+
+			const_iterator() = default;
+
+			reference operator*() const { return top().node->entries[top().entry]; }
+			pointer   operator->() const { return &**this; }
+
+			const_iterator& operator++()
+			{
+				top().entry++;
+				settle();
+				return *this;
+			}
+
+			const_iterator operator++(int)
+			{
+				auto previous = *this;
+				++*this;
+				return previous;
+			}
+
+			bool operator==(const const_iterator& other) const
+			{
+				if ((_depth == 0) || (other._depth == 0)) return _depth == other._depth;
+				return &**this == &*other;
+			}
+
+		private:
+			Frame&       top() { return _stack[_depth - 1]; }
+			const Frame& top() const { return _stack[_depth - 1]; }
+
+			void push(const Node* node, uint32_t entry, uint32_t child) { _stack[_depth++] = {node, entry, child}; }
+
+			/// @brief Advances to the next entry in depth-first order: a node's entries before its children.
+			void settle()
+			{
+				while (_depth > 0)
+				{
+					auto& frame = top();
+					if (frame.entry < frame.node->entries.size()) return;
+					if (frame.child < frame.node->children.size())
+					{
+						auto child = frame.node->children[frame.child++].get();
+						push(child, 0, 0);
+						continue;
+					}
+					_depth--;
+				}
+			}
+
+			std::array<Frame, MaxDepth> _stack {};
+			unsigned                    _depth {0};
+		};
+
+		using iterator = const_iterator;
+
+		HamtMap() = default;
+
+		/// @brief O(1): the copy shares every node with the source.
+		HamtMap(const HamtMap&)            = default;
+		HamtMap& operator=(const HamtMap&) = default;
+		HamtMap(HamtMap&&) noexcept        = default;
+		HamtMap& operator=(HamtMap&&)      = default;
+
+		const_iterator begin() const
+		{
+			const_iterator iter {};
+			if (_root)
+			{
+				iter.push(_root.get(), 0, 0);
+				iter.settle();
+			}
+			return iter;
+		}
+
+		const_iterator end() const { return {}; }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+
+		size_type size() const { return _size; }
+		bool      empty() const { return _size == 0; }
+
+		void clear()
+		{
+			_root.reset();
+			_size = 0;
+		}
+
+		const_iterator find(const Key& key) const
+		{
+			const_iterator iter {};
+			auto           hash = Hash {}(key);
+			const Node*    node = _root.get();
+
+			for (unsigned shift = 0; node != nullptr; shift += BitsPerLevel)
+			{
+				if (shift >= HashBits)
+				{
+					for (uint32_t i = 0; i < node->entries.size(); i++)
+					{
+						if (KeyEqual {}(node->entries[i].first, key))
+						{
+							iter.push(node, i, 0);
+							return iter;
+						}
+					}
+					return {};
+				}
+
+				auto bit = bitFor(hash, shift);
+				if (node->dataMap & bit)
+				{
+					auto index = indexOf(node->dataMap, bit);
+					if (!KeyEqual {}(node->entries[index].first, key)) return {};
+					iter.push(node, index, 0);
+					return iter;
+				}
+				if ((node->nodeMap & bit) == 0) return {};
+
+				// Resume after this child once the sub-trie has been iterated
+				auto index = indexOf(node->nodeMap, bit);
+				iter.push(node, static_cast<uint32_t>(node->entries.size()), index + 1);
+				node = node->children[index].get();
+			}
+
+			return {};
+		}
+
+		bool contains(const Key& key) const { return find(key) != end(); }
+
+		size_type count(const Key& key) const { return contains(key) ? 1 : 0; }
+
+		/**
+		 * @brief Inserts or replaces the value of key, copying only the path from the root to the entry.
+		 *
+		 * @return std::pair<const_iterator, bool> The entry and true if it was inserted
+		 */
+		template <class K, class V>
+		std::pair<const_iterator, bool> insert_or_assign(K&& key, V&& value)
+		{
+			bool inserted {false};
+			Key  stored(std::forward<K>(key));
+			auto hash = Hash {}(stored);
+
+			_root = insert(_root.get(), 0, hash, stored, std::forward<V>(value), inserted);
+			if (inserted) _size++;
+
+			return {find(stored), inserted};
+		}
+
+		/**
+		 * @brief Removes key, copying only the path from the root to the entry.
+		 *
+		 * @return size_type The number of entries removed
+		 */
+		size_type erase(const Key& key)
+		{
+			bool erased {false};
+			auto root = erase(_root, 0, Hash {}(key), key, erased);
+			if (!erased) return 0;
+
+			_root = std::move(root);
+			_size--;
+			return 1;
+		}
+
+	private:
+		static uint32_t bitFor(size_t hash, unsigned shift) { return uint32_t {1} << ((hash >> shift) & 0x1f); }
+
+		static uint32_t indexOf(uint32_t bitmap, uint32_t bit) { return static_cast<uint32_t>(std::popcount(bitmap & (bit - 1))); }
+
+		/// @brief Copies entries, replacing (or inserting when insert is true) the entry at index with the new one.
+		template <class V>
+		static std::vector<value_type> withEntry(const std::vector<value_type>& entries, size_t index, bool insert, const Key& key, V&& value)
+		{
+			std::vector<value_type> copy {};
+			copy.reserve(entries.size() + (insert ? 1 : 0));
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				if (i == index) copy.emplace_back(key, std::forward<V>(value));
+				if ((i != index) || insert) copy.push_back(entries[i]);
+			}
+			if (index == entries.size()) copy.emplace_back(key, std::forward<V>(value));
+			return copy;
+		}
+
+		/// @brief Copies entries without the entry at index.
+		static std::vector<value_type> withoutEntry(const std::vector<value_type>& entries, size_t index)
+		{
+			std::vector<value_type> copy {};
+			copy.reserve(entries.size() - 1);
+			for (size_t i = 0; i < entries.size(); i++)
+				if (i != index) copy.push_back(entries[i]);
+			return copy;
+		}
+
+		/// @brief Builds the sub-trie holding two entries whose hashes agree up to shift.
+		static NodePtr merge(const value_type& first, size_t firstHash, value_type&& second, size_t secondHash, unsigned shift)
+		{
+			auto node = std::make_shared<Node>();
+
+			if (shift >= HashBits)
+			{
+				node->entries.reserve(2);
+				node->entries.push_back(first);
+				node->entries.push_back(std::move(second));
+				return node;
+			}
+
+			auto firstBit  = bitFor(firstHash, shift);
+			auto secondBit = bitFor(secondHash, shift);
+			if (firstBit == secondBit)
+			{
+				node->nodeMap = firstBit;
+				node->children.push_back(merge(first, firstHash, std::move(second), secondHash, shift + BitsPerLevel));
+				return node;
+			}
+
+			node->dataMap = firstBit | secondBit;
+			node->entries.reserve(2);
+			if (firstBit < secondBit)
+			{
+				node->entries.push_back(first);
+				node->entries.push_back(std::move(second));
+			}
+			else
+			{
+				node->entries.push_back(std::move(second));
+				node->entries.push_back(first);
+			}
+			return node;
+		}
+
+		template <class V>
+		static NodePtr insert(const Node* node, unsigned shift, size_t hash, const Key& key, V&& value, bool& inserted)
+		{
+			static const std::vector<value_type> none {};
+			const auto&                          entries = node ? node->entries : none;
+
+			if (shift >= HashBits)
+			{
+				size_t index {0};
+				while ((index < entries.size()) && !KeyEqual {}(entries[index].first, key))
+					index++;
+
+				inserted = (index == entries.size());
+				return std::make_shared<Node>(Node {0, 0, withEntry(entries, index, inserted, key, std::forward<V>(value)), {}});
+			}
+
+			auto bit = bitFor(hash, shift);
+
+			if (node && (node->dataMap & bit))
+			{
+				auto        index    = indexOf(node->dataMap, bit);
+				const auto& existing = node->entries[index];
+				if (KeyEqual {}(existing.first, key))
+					return std::make_shared<Node>(
+							Node {node->dataMap, node->nodeMap, withEntry(entries, index, false, key, std::forward<V>(value)), node->children});
+
+				// Push the existing entry down into a new sub-trie along with the new entry
+				inserted   = true;
+				auto child = merge(existing, Hash {}(existing.first), value_type(key, std::forward<V>(value)), hash, shift + BitsPerLevel);
+				auto copy  = std::make_shared<Node>(Node {node->dataMap & ~bit, node->nodeMap | bit, withoutEntry(entries, index), node->children});
+				copy->children.insert(copy->children.begin() + indexOf(copy->nodeMap, bit), std::move(child));
+				return copy;
+			}
+
+			if (node && (node->nodeMap & bit))
+			{
+				auto index            = indexOf(node->nodeMap, bit);
+				auto copy             = std::make_shared<Node>(*node);
+				copy->children[index] = insert(node->children[index].get(), shift + BitsPerLevel, hash, key, std::forward<V>(value), inserted);
+				return copy;
+			}
+
+			inserted     = true;
+			auto dataMap = (node ? node->dataMap : 0) | bit;
+			return std::make_shared<Node>(Node {dataMap,
+			                                    node ? node->nodeMap : 0,
+			                                    withEntry(entries, indexOf(dataMap, bit), true, key, std::forward<V>(value)),
+			                                    node ? node->children : std::vector<NodePtr> {}});
+		}
+
+		/// @return The new node; empty when the node became empty. Unchanged when the key was not found.
+		static NodePtr erase(const NodePtr& node, unsigned shift, size_t hash, const Key& key, bool& erased)
+		{
+			if (!node) return node;
+
+			if (shift >= HashBits)
+			{
+				for (size_t index = 0; index < node->entries.size(); index++)
+				{
+					if (KeyEqual {}(node->entries[index].first, key))
+					{
+						erased = true;
+						if (node->entries.size() == 1) return {};
+						return std::make_shared<Node>(Node {0, 0, withoutEntry(node->entries, index), {}});
+					}
+				}
+				return node;
+			}
+
+			auto bit = bitFor(hash, shift);
+
+			if (node->dataMap & bit)
+			{
+				auto index = indexOf(node->dataMap, bit);
+				if (!KeyEqual {}(node->entries[index].first, key)) return node;
+
+				erased = true;
+				if ((node->entries.size() == 1) && node->children.empty()) return {};
+				return std::make_shared<Node>(Node {node->dataMap & ~bit, node->nodeMap, withoutEntry(node->entries, index), node->children});
+			}
+
+			if (node->nodeMap & bit)
+			{
+				auto index = indexOf(node->nodeMap, bit);
+				auto child = erase(node->children[index], shift + BitsPerLevel, hash, key, erased);
+				if (!erased) return node;
+
+				auto copy = std::make_shared<Node>(*node);
+				if (child && !child->isSingleEntry())
+				{
+					copy->children[index] = std::move(child);
+					return copy;
+				}
+
+				// Keep the trie canonical: a sub-trie left with a single entry is inlined into this node
+				copy->children.erase(copy->children.begin() + index);
+				copy->nodeMap &= ~bit;
+				if (child)
+				{
+					copy->dataMap |= bit;
+					const auto& entry = child->entries.front();
+					copy->entries     = withEntry(node->entries, indexOf(copy->dataMap, bit), true, entry.first, entry.second);
+				}
+				if (copy->entries.empty() && copy->children.empty()) return {};
+				return copy;
+			}
+
+			return node;
+		}
+
+	private:
+		NodePtr   _root {};
+		size_type _size {0};
+	};
+} // namespace siddiqsoft
+
+#endif // !HamtMap_HPP
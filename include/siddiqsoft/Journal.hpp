@@ -0,0 +1,471 @@
+/*
+	Append-only write-ahead journal with group commit
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#pragma once
+#ifndef Journal_HPP
+#define Journal_HPP
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace siddiqsoft
+{
+	/// @brief Tuning for a Journal
+	struct JournalOptions
+	{
+		/// @brief Longest time an appended record waits for the next group commit
+		std::chrono::milliseconds flushInterval {2};
+		/// @brief Buffered bytes which trigger a group commit before the interval elapses
+		size_t maxBatchBytes {1024 * 1024};
+		/// @brief When true, mutating calls on the owning container return only once their record is durable
+		bool waitForDurability {true};
+	};
+
+
+	/**
+	 * @brief Journal. Append-only write-ahead log. Records are appended to an in-memory buffer and a background
+	 *        thread writes each batch with a single write and a single fdatasync (group commit) so that the cost of
+	 *        durability is shared by all records in the batch. Every record receives a log sequence number (LSN);
+	 *        waitDurable(lsn) blocks until the record is on disk.
+	 *        Frames are [u32 bytes][u32 FNV-1a checksum][payload]; a torn or corrupt tail (crash during a write)
+	 *        ends replay and is truncated when the journal is reopened.
+	 *        Once a commit fails the journal is failed: further appends throw and waitDurable returns false for
+	 *        every record which was not yet durable. checkpoint() drops the records covered by a snapshot.
+	 *        Durability relies on fdatasync (fsync on macOS) and is only available on POSIX; elsewhere the batch
+	 *        is flushed to the OS.
+	 */
+	class Journal
+	{
+		struct Frame
+		{
+			uint32_t bytes {0};
+			uint32_t checksum {0};
+		};
+
+	public:
+		Journal& operator=(const Journal&) = delete;
+		Journal(const Journal&)            = delete;
+		Journal(Journal&&)                 = delete;
+		auto operator=(Journal&&)          = delete;
+
+		/**
+		 * @brief Opens (or creates) the journal for appending and starts the flush thread.
+		 *        The LSN continues from the number of valid records already in the file.
+		 *
+		 * @param path The journal file
+		 * @param options Flush interval and batch size
+		 */
+		explicit Journal(const std::filesystem::path& path, JournalOptions options = {})
+			: Journal(path, options, [](std::string_view) {})
+		{
+		}
+
+		/**
+		 * @brief Same as above but also hands every valid record to onRecord, in order, so that the file is read
+		 *        only once at startup.
+		 *
+		 * @param path The journal file
+		 * @param options Flush interval and batch size
+		 * @param onRecord Invoked with each payload before the journal accepts appends
+		 */
+		template <class Callback>
+		Journal(const std::filesystem::path& path, JournalOptions options, Callback&& onRecord)
+			: _path(path)
+			, _options(options)
+		{
+			uint64_t validBytes {0};
+			auto     existed = std::filesystem::exists(path);
+			_appendedLsn = _durableLsn = replay(path, std::forward<Callback>(onRecord), &validBytes);
+
+			// Drop a torn tail so that new records follow the last valid one
+			if (existed && (std::filesystem::file_size(path) > validBytes)) std::filesystem::resize_file(path, validBytes);
+
+			openForAppend();
+			// A new file is only durable once its directory entry is
+			if (!existed) syncDirectory();
+			_flusher = std::thread([this]() { run(); });
+		}
+
+		/// @brief Commits the buffered records and stops the flush thread.
+		~Journal()
+		{
+			if (std::lock_guard<std::mutex> _ {_mutex}; true) _stopping = true;
+			_flushSignal.notify_all();
+			if (_flusher.joinable()) _flusher.join();
+			closeFile();
+		}
+
+		/**
+		 * @brief Buffers a record for the next group commit.
+		 *
+		 * @param payload The record
+		 * @return uint64_t The LSN of the record
+		 * @throws std::runtime_error once the journal failed
+		 */
+		uint64_t append(std::string_view payload)
+		{
+			Frame frame {static_cast<uint32_t>(payload.size()), checksum(payload)};
+
+			std::lock_guard<std::mutex> _ {_mutex};
+
+			if (_failed) throw std::runtime_error(std::format("{} - Journal {} failed; appends are rejected", __FUNCTION__, _path.string()));
+
+			// The flusher sleeps until there is something to commit
+			if (_buffer.empty() || (_buffer.size() + sizeof(frame) + payload.size() >= _options.maxBatchBytes)) _flushSignal.notify_one();
+			_buffer.append(reinterpret_cast<const char*>(&frame), sizeof(frame));
+			_buffer.append(payload);
+
+			return ++_appendedLsn;
+		}
+
+		/// @brief Returns true once a commit failed; see append.
+		bool failed()
+		{
+			std::lock_guard<std::mutex> _ {_mutex};
+			return _failed;
+		}
+
+		/**
+		 * @brief Drops the records up to and including lsn from the file, typically once a snapshot which contains
+		 *        them is durable. The remaining records are rewritten to a new file which replaces the journal; the
+		 *        appends wait meanwhile. Records after lsn which are still buffered are committed to the new file.
+		 *
+		 * @param lsn The last record covered by the snapshot
+		 * @return false if the journal failed or the records could not be made durable
+		 * @throws std::runtime_error when the journal cannot be rewritten; the journal is then failed
+		 */
+		bool checkpoint(uint64_t lsn)
+		{
+			if (!waitDurable(lsn)) return false;
+
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			// The flusher cannot start another commit while we hold the mutex
+			_durableSignal.wait(lock, [&] { return !_committing; });
+			if (_failed) return false;
+			if (lsn <= _checkpointLsn) return true;
+
+			try
+			{
+				auto temporary = _path;
+				temporary += ".compact";
+				uint64_t skip = lsn - _checkpointLsn;
+				if (std::ofstream file {temporary, std::ios::binary | std::ios::trunc}; file)
+				{
+					replay(_path, [&](std::string_view payload) {
+						if (skip > 0)
+						{
+							skip--;
+							return;
+						}
+						Frame frame {static_cast<uint32_t>(payload.size()), checksum(payload)};
+						file.write(reinterpret_cast<const char*>(&frame), sizeof(frame));
+						file.write(payload.data(), payload.size());
+					});
+					if (!file.flush()) throw std::runtime_error(std::format("{} - Failed to write {}", __FUNCTION__, temporary.string()));
+				}
+				else
+				{
+					throw std::runtime_error(std::format("{} - Failed to create {}", __FUNCTION__, temporary.string()));
+				}
+				syncFile(temporary);
+
+				closeFile();
+				std::filesystem::rename(temporary, _path);
+				syncDirectory();
+				openForAppend();
+			}
+			catch (...)
+			{
+				_failed = true;
+				_durableSignal.notify_all();
+				throw;
+			}
+
+			_checkpointLsn = lsn;
+			_counterCheckpoints++;
+			return true;
+		}
+
+		/// @brief Returns the number of checkpoints which rewrote the journal.
+		auto checkpointCounter() -> uint64_t
+		{
+			std::lock_guard<std::mutex> _ {_mutex};
+			return _counterCheckpoints;
+		}
+
+		/**
+		 * @brief Blocks until the record with the given LSN is durable.
+		 *
+		 * @return false if the journal failed to write; the record is not durable
+		 */
+		bool waitDurable(uint64_t lsn)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			_durableSignal.wait(lock, [&] { return _failed || (_durableLsn >= lsn); });
+			return _durableLsn >= lsn;
+		}
+
+		/// @brief Blocks until every record appended so far is durable.
+		bool flush() { return waitDurable(appendedLsn()); }
+
+		/// @brief Returns the LSN of the last appended record.
+		uint64_t appendedLsn()
+		{
+			std::lock_guard<std::mutex> _ {_mutex};
+			return _appendedLsn;
+		}
+
+		/// @brief Returns the LSN of the last durable record.
+		uint64_t durableLsn()
+		{
+			std::lock_guard<std::mutex> _ {_mutex};
+			return _durableLsn;
+		}
+
+		/// @brief Returns the number of group commits performed.
+		auto commitCounter() -> uint64_t
+		{
+			std::lock_guard<std::mutex> _ {_mutex};
+			return _counterCommits;
+		}
+
+		/**
+		 * @brief Invokes callback with every valid record of the journal, in order. Stops at the first torn or
+		 *        corrupt record.
+		 *
+		 * @param path The journal file; a missing file has no records
+		 * @param callback Invoked with each payload
+		 * @param validBytes Optional; receives the length of the valid prefix of the file
+		 * @return uint64_t The number of records replayed
+		 */
+		template <class Callback>
+		static uint64_t replay(const std::filesystem::path& path, Callback&& callback, uint64_t* validBytes = nullptr)
+		{
+			uint64_t records {0};
+			uint64_t offset {0};
+
+			if (std::ifstream file {path, std::ios::binary}; file)
+			{
+				std::string      contents {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+				std::string_view data {contents};
+
+				while (data.size() >= sizeof(Frame))
+				{
+					Frame frame {};
+					std::memcpy(&frame, data.data(), sizeof(frame));
+					if (data.size() - sizeof(frame) < frame.bytes) break;
+
+					auto payload = data.substr(sizeof(frame), frame.bytes);
+					if (checksum(payload) != frame.checksum) break;
+
+					callback(payload);
+					records++;
+					offset += sizeof(frame) + frame.bytes;
+					data.remove_prefix(sizeof(frame) + frame.bytes);
+				}
+			}
+
+			if (validBytes != nullptr) *validBytes = offset;
+			return records;
+		}
+
+	private:
+		static uint32_t checksum(std::string_view payload)
+		{
+			uint32_t hash {2166136261u};
+			for (auto c : payload)
+				hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+			return hash;
+		}
+
+		void openForAppend()
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			_fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+			if (_fd < 0) throw std::runtime_error(std::format("{} - Failed to open {} errno:{}", __FUNCTION__, _path.string(), errno));
+#else
+			_file.open(_path, std::ios::binary | std::ios::app);
+			if (!_file) throw std::runtime_error(std::format("{} - Failed to open {}", __FUNCTION__, _path.string()));
+#endif
+		}
+
+		void closeFile()
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			if (_fd >= 0) ::close(_fd);
+			_fd = -1;
+#else
+			_file.close();
+#endif
+		}
+
+		/// @brief Makes the contents of path durable (POSIX only).
+		static void syncFile(const std::filesystem::path& path)
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			auto fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) throw std::runtime_error(std::format("{} - Failed to open {} errno:{}", __FUNCTION__, path.string(), errno));
+			auto synced = (::fsync(fd) == 0);
+			auto error  = errno;
+			::close(fd);
+			if (!synced) throw std::runtime_error(std::format("{} - Failed to sync {} errno:{}", __FUNCTION__, path.string(), error));
+#endif
+		}
+
+		/// @brief Makes the directory entry of the journal durable (POSIX only).
+		void syncDirectory() const
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			auto directory = _path.has_parent_path() ? _path.parent_path() : std::filesystem::path(".");
+			auto fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+			if (fd < 0) throw std::runtime_error(std::format("{} - Failed to open {} errno:{}", __FUNCTION__, directory.string(), errno));
+			auto synced = (::fsync(fd) == 0);
+			auto error  = errno;
+			::close(fd);
+			if (!synced) throw std::runtime_error(std::format("{} - Failed to sync {} errno:{}", __FUNCTION__, directory.string(), error));
+#endif
+		}
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			while (true)
+			{
+				// Idle until the first record arrives, then give the batch up to the flush interval to fill
+				_flushSignal.wait(lock, [&] { return _stopping || !_buffer.empty(); });
+				_flushSignal.wait_for(lock, _options.flushInterval, [&] { return _stopping || (_buffer.size() >= _options.maxBatchBytes); });
+
+				if (_buffer.empty())
+				{
+					if (_stopping) return;
+					continue;
+				}
+
+				// Appenders keep filling a fresh buffer while this batch is written
+				std::string batch {};
+				batch.swap(_buffer);
+				auto lsn    = _appendedLsn;
+				_committing = true;
+
+				lock.unlock();
+				auto written = commit(batch);
+				lock.lock();
+
+				_committing = false;
+				if (written)
+				{
+					_durableLsn = lsn;
+					_counterCommits++;
+				}
+				else
+				{
+					_failed = true;
+				}
+				_durableSignal.notify_all();
+				if (_failed) return;
+			}
+		}
+
+		/// @brief Writes the batch and waits for it to reach the disk.
+		bool commit(std::string_view batch)
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			while (!batch.empty())
+			{
+				auto rc = ::write(_fd, batch.data(), batch.size());
+				if (rc < 0 && errno == EINTR) continue;
+				if (rc < 0) return false;
+				batch.remove_prefix(static_cast<size_t>(rc));
+			}
+#if defined(__APPLE__)
+			return ::fsync(_fd) == 0;
+#else
+			return ::fdatasync(_fd) == 0;
+#endif
+#else
+			_file.write(batch.data(), batch.size());
+			return static_cast<bool>(_file.flush());
+#endif
+		}
+
+	private:
+		std::filesystem::path   _path;
+		JournalOptions          _options {};
+		std::mutex              _mutex {};
+		std::condition_variable _flushSignal {};
+		std::condition_variable _durableSignal {};
+		std::string             _buffer {};
+		uint64_t                _appendedLsn {0};
+		uint64_t                _durableLsn {0};
+		uint64_t                _counterCommits {0};
+		/// @brief LSN of the last record dropped by checkpoint; the first record of the file follows it
+		uint64_t                _checkpointLsn {0};
+		uint64_t                _counterCheckpoints {0};
+		bool                    _stopping {false};
+		bool                    _failed {false};
+		/// @brief True while the flusher writes a batch outside the lock
+		bool                    _committing {false};
+#if defined(__unix__) || defined(__APPLE__)
+		int _fd {-1};
+#else
+		std::ofstream _file {};
+#endif
+		std::thread _flusher {};
+	};
+} // namespace siddiqsoft
+
+#endif // !Journal_HPP
@@ -42,11 +42,43 @@
 #include <memory>
 #include <string>
 #include <atomic>
+#include <mutex>
+#include <format>
+#include <stdexcept>
 #include <shared_mutex>
 #include <type_traits>
+#include <filesystem>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <cstring>
+#include <ranges>
+#include <unordered_set>
+
+#include "siddiqsoft/ChangeFeed.hpp"
+#include "siddiqsoft/Codec.hpp"
+#include "siddiqsoft/ColumnIndex.hpp"
+#include "siddiqsoft/ExportWriter.hpp"
+#include "siddiqsoft/Journal.hpp"
+#include "siddiqsoft/SecondaryIndex.hpp"
+#include "siddiqsoft/SnapshotFile.hpp"
 
 namespace siddiqsoft
 {
+	/// @brief How RWLContainer::bulkLoad treats a key which occurs more than once in the batch or is already present
+	enum class DuplicatePolicy
+	{
+		/// @brief The existing entry, or the first occurrence in the batch, is kept
+		KeepFirst,
+		/// @brief The last occurrence in the batch replaces any earlier one and the existing entry
+		KeepLast,
+		/// @brief Throws std::invalid_argument and loads nothing
+		Fail
+	};
+
+
 	/// @brief Implements an unordered map container with reader-writer locking. The internal storage is via shared_ptr so the
 	/// @tparam StorageType Can be any element but avoid using pointers, shared_ptr, unique_ptr as the underlying storage is shared_ptr<StorageType>
 	template <class KeyType,
@@ -66,21 +98,7 @@ namespace siddiqsoft
 		/// @return The newly inserted item or existing item
 		StorageTypePtr add(const KeyType& key, const StorageType&& value)
 		{
-			std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex);
-
-			// Search for any existing item..
-			auto itemFound = _container.find(key);
-			if (itemFound != _container.end() && FailOnCollission)
-				return {};
-			else if (itemFound != _container.end() && !FailOnCollission && !ReplaceExisting)
-				return itemFound->second;
-
-			// Item not found.. ReplaceExisting=> true and FailOnCollission=> false
-			if (auto [iter, rv] = _container.insert_or_assign(key, std::make_shared<StorageType>(value));
-			    iter != _container.end())                            // insert/assign new item
-				return _counterAdds++ ? iter->second : iter->second; // shortcut expression
-
-			throw std::runtime_error(std::format("{} - Failed to add for key:{}", __FUNCTION__, key));
+			return upsert(key, [&]() { return std::make_shared<StorageType>(value); });
 		}
 
 
@@ -90,20 +108,7 @@ namespace siddiqsoft
 		/// @return The newly inserted item or existing item
 		StorageTypePtr add(const KeyType& key, const StorageTypePtr&& value)
 		{
-			std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex);
-
-			// Search for any existing item..
-			auto itemFound = _container.find(key);
-			if (itemFound != _container.end() && FailOnCollission)
-				return {};
-			else if (itemFound != _container.end() && !FailOnCollission && !ReplaceExisting)
-				return itemFound->second;
-
-			// Item not found.. ReplaceExisting=> true and FailOnCollission=> false
-			if (auto [iter, rv] = _container.insert_or_assign(key, value); iter != _container.end()) // insert/assign new item
-				return _counterAdds++ ? iter->second : iter->second;                                 // shortcut expression
-
-			throw std::runtime_error(std::format("{} - Failed to add for key:{}", __FUNCTION__, key));
+			return upsert(key, [&]() { return value; });
 		}
 
 
@@ -114,72 +119,546 @@ namespace siddiqsoft
 		/// WARNING! The add happens within a lock!
 		/// @return The newly created object or an existing object associated with the key.
 		StorageTypePtr add(const KeyType& key, std::function<StorageTypePtr(const KeyType&)>&& newObjectCallback)
+		{
+			return upsert(key, [&]() { return newObjectCallback(key); });
+		}
+
+
+		[[nodiscard]] StorageTypePtr remove(const KeyType& key)
+		{
+			StorageTypePtr retItem {};
+			uint64_t       lsn {0};
+
+			if (std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex); true)
+			{
+				// Search for any existing item..
+				if (auto item = _container->find(key); item != _container->end())
+				{
+					retItem = item->second;
+
+					// Journaled first so that a failed journal rejects the removal before it is applied
+					lsn = journalChange(ChangeOp::Remove, key, {});
+					updateIndexes(key, {});
+					writable().erase(key);
+					_counterRemoves++;
+					feedChange(ChangeOp::Remove, key, {});
+				}
+			}
+
+			// Outside the lock so that concurrent writers share the group commit
+			awaitDurable(lsn, [&]() { revert(key, {}, retItem); });
+			return retItem;
+		}
+
+
+		StorageTypePtr find(const KeyType& key)
+		{
+			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
+
+			if (auto item = _container->find(key); item != _container->end()) return item->second;
+
+			return {};
+		}
+
+
+		auto size() const
+		{
+			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
+
+			return _container->size();
+		}
+
+
+		/// @brief Invokes the callback for every item within the reader lock until it returns true.
+		/// The entries are shared with snapshots (and other readers) so the callback receives them read-only.
+		/// @param scanCallback Returns true to stop the scan
+		/// @return The item for which the callback returned true; empty otherwise
+		StorageTypePtr scan(std::function<bool(const KeyType&, const StorageTypePtr&)> scanCallback)
+		{
+			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
+
+			for (const auto& item : *_container)
+			{
+				if (scanCallback(item.first, item.second)) return item.second;
+			}
+
+			return {};
+		}
+
+		/// @brief Opt-in: records every successful add (insert or replace) and remove in a bounded ChangeFeed
+		/// which followers read by cursor instead of periodically rescanning the container.
+		/// @param capacity Number of records retained before the oldest are overwritten
+		void enableChangeFeed(size_t capacity = 4096)
 		{
 			std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex);
 
-			// Search for any existing item..
-			auto itemFound = _container.find(key);
-			if (itemFound != _container.end() && FailOnCollission)
-				return {}; // collission but asked to fail
-			else if (itemFound != _container.end() && !FailOnCollission && !ReplaceExisting)
-				return itemFound->second; // found existing; return
+			if (!_changeFeed) _changeFeed = std::make_unique<ChangeFeed<KeyType, StorageType>>(capacity);
+		}
 
-			// Item not found.. ReplaceExisting=> true and FailOnCollission=> false
-			if (auto [iter, rv] = _container.insert_or_assign(key, newObjectCallback(key));
-			    iter != _container.end())                            // insert/assign new item
-				return _counterAdds++ ? iter->second : iter->second; // shortcut expression; returns added item
 
-			throw std::runtime_error(std::format("{} - Failed to add for key:{}", __FUNCTION__, key));
+		/// @brief Returns the change feed; see enableChangeFeed
+		/// @return The change feed
+		ChangeFeed<KeyType, StorageType>& changeFeed()
+		{
+			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
+
+			if (!_changeFeed) throw std::runtime_error(std::format("{} - Change feed is not enabled", __FUNCTION__));
+			return *_changeFeed;
 		}
 
 
-		[[nodiscard]] StorageTypePtr remove(const KeyType& key)
+		/// @brief Scans the container and returns the change feed cursor matching the scanned state.
+		/// Followers use this to bootstrap and then read the change feed from the returned cursor.
+		/// @param scanCallback Invoked for every item (read-only) within the reader lock
+		/// @return The change feed version of the first mutation not reflected by the scan
+		uint64_t scanWithCursor(std::function<void(const KeyType&, const StorageTypePtr&)> scanCallback)
+		{
+			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
+
+			if (!_changeFeed) throw std::runtime_error(std::format("{} - Change feed is not enabled", __FUNCTION__));
+			for (const auto& item : *_container)
+			{
+				scanCallback(item.first, item.second);
+			}
+
+			// Mutations append under the writer lock so the head is stable here
+			return _changeFeed->head();
+		}
+
+		/// @brief Writes a compact binary image of the container for a fast warm restart (see loadSnapshot).
+		/// The image is taken from a snapshot(); the items are encoded into hash partitions in parallel without
+		/// any lock so neither readers nor writers wait for the encoding or the IO. With the default unordered_map
+		/// backend the first write during the save still copies the whole map (see snapshot).
+		/// With a journal (see enableJournal) the records covered by the image are dropped from the journal once the
+		/// image is durable; load this image with loadSnapshot before enableJournal at the next startup.
+		/// @param path Destination; written to a temporary file and renamed into place
+		/// @param codec Encodes the StorageType
+		/// @param keyCodec Encodes the KeyType; defaults to DefaultCodec<KeyType>
+		/// @return The number of items written
+		template <class ValueCodec, class KeyCodec = DefaultCodec<KeyType>>
+			requires Codec<ValueCodec, StorageType> && Codec<KeyCodec, KeyType>
+		uint64_t saveSnapshot(const std::filesystem::path& path, const ValueCodec& codec = {}, const KeyCodec& keyCodec = {})
+		{
+			Snapshot view {};
+			uint64_t lsn {0};
+			if (std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex); true)
+			{
+				// Journal appends happen under the writer lock so the view holds exactly the records up to lsn
+				view = Snapshot(_container);
+				if (_journal) lsn = _journal->appendedLsn();
+			}
+
+			std::vector<SnapshotFile::PartitionWriter>                      partitions(snapshotPartitions(view.size()));
+			std::vector<std::vector<const typename StorageContainer::value_type*>> members(partitions.size());
+			for (const auto& item : view)
+				members[std::hash<KeyType> {}(item.first) % partitions.size()].push_back(&item);
+
+			std::vector<std::exception_ptr> errors(partitions.size());
+			if (std::vector<std::jthread> workers {}; true)
+			{
+				for (size_t p = 0; p < partitions.size(); p++)
+					workers.emplace_back([&, p]() {
+						try
+						{
+							for (auto item : members[p])
+								partitions[p].append(keyCodec.encode(item->first), codec.encode(*item->second));
+						}
+						catch (...)
+						{
+							errors[p] = std::current_exception();
+						}
+					});
+			}
+			for (auto& error : errors)
+				if (error) std::rethrow_exception(error);
+
+			SnapshotFile::write(path, partitions);
+			if (_journal && !_journal->checkpoint(lsn))
+				throw std::runtime_error(std::format("{} - Journal failed; the snapshot was written but the journal not checkpointed", __FUNCTION__));
+			return view.size();
+		}
+
+
+		/// @brief Loads an image written by saveSnapshot. The file is mapped and its partitions are decoded in
+		/// parallel; the decoded items are then inserted under a single writer lock into presized buckets.
+		/// Loaded items replace existing items with the same key.
+		/// @param path Source
+		/// @param codec Decodes the StorageType
+		/// @param keyCodec Decodes the KeyType; defaults to DefaultCodec<KeyType>
+		/// @return The number of items loaded
+		template <class ValueCodec, class KeyCodec = DefaultCodec<KeyType>>
+			requires Codec<ValueCodec, StorageType> && Codec<KeyCodec, KeyType>
+		uint64_t loadSnapshot(const std::filesystem::path& path, const ValueCodec& codec = {}, const KeyCodec& keyCodec = {})
+		{
+			SnapshotFile                                                 image {path};
+			std::vector<std::vector<std::pair<KeyType, StorageTypePtr>>> partitions(image.partitionCount());
+			std::vector<std::exception_ptr>                              errors(image.partitionCount());
+
+			if (std::vector<std::jthread> workers {}; true)
+			{
+				for (size_t p = 0; p < partitions.size(); p++)
+					workers.emplace_back([&, p]() {
+						try
+						{
+							partitions[p].reserve(image.itemCount(p));
+							image.forEach(p, [&](std::string_view key, std::string_view value) {
+								partitions[p].emplace_back(keyCodec.decode(key), std::make_shared<StorageType>(codec.decode(value)));
+							});
+						}
+						catch (...)
+						{
+							errors[p] = std::current_exception();
+						}
+					});
+			}
+			for (auto& error : errors)
+				if (error) std::rethrow_exception(error);
+
+			applyBatch(partitions, DuplicatePolicy::KeepLast);
+			return image.itemCount();
+		}
+
+
+		/// @brief Loads a batch of key/value pairs for cold starts.
+		/// The items are allocated, hash-partitioned and de-duplicated in parallel without any lock. When the container
+		/// is empty the new StorageContainer is built outside the lock as well and swapped in; otherwise the batch is
+		/// merged under a single writer lock. The whole batch is validated (duplicates, unique indexes) before any of it
+		/// is applied so a failure leaves the container, its indexes and the change feed and journal untouched.
+		/// Insertion into the StorageContainer itself is serial; expect a few times the throughput of add() (no per-entry
+		/// locking or rehashing), not a speedup proportional to the threads.
+		/// Pass the range as an rvalue to move the keys and values out of it.
+		/// @param range Random access range of pairs of KeyType and StorageType (or StorageTypePtr)
+		/// @param threads Number of threads used for the parallel phase; defaults to the hardware threads
+		/// @param policy Treatment of keys which repeat within the batch or exist in the container
+		/// @return The number of entries inserted or replaced
+		template <std::ranges::random_access_range Range>
+			requires std::ranges::sized_range<Range>
+		uint64_t bulkLoad(Range&&         range,
+		                  size_t          threads = std::thread::hardware_concurrency(),
+		                  DuplicatePolicy policy  = DuplicatePolicy::KeepFirst)
+		{
+			constexpr bool MoveItems = !std::is_lvalue_reference_v<Range>;
+
+			auto itemCount  = static_cast<size_t>(std::ranges::size(range));
+			auto partitions = std::clamp<size_t>(std::min(threads, itemCount / 1024), 1, 64);
+
+			// Each thread partitions its slice; concatenating the slices per partition keeps the input order
+			std::vector<std::vector<Batch>> slices(partitions, std::vector<Batch>(partitions));
+			parallelFor(partitions, [&](size_t t) {
+				auto first = itemCount * t / partitions;
+				auto last  = itemCount * (t + 1) / partitions;
+				for (auto i = first; i < last; i++)
+				{
+					auto&& item      = std::ranges::begin(range)[i];
+					auto&  partition = slices[t][std::hash<KeyType> {}(item.first) % partitions];
+					if constexpr (MoveItems)
+						partition.emplace_back(std::move(item.first), makeStorage(std::move(item.second)));
+					else
+						partition.emplace_back(item.first, makeStorage(item.second));
+				}
+			});
+
+			// Equal keys share a partition so each partition resolves its duplicates independently
+			std::vector<Batch>              resolved(partitions);
+			std::vector<std::exception_ptr> errors(partitions);
+			parallelFor(partitions, [&](size_t p) {
+				std::unordered_map<KeyType, size_t> positions {};
+				for (auto& slice : slices)
+				{
+					for (auto& item : slice[p])
+					{
+						if (auto [position, rv] = positions.try_emplace(item.first, resolved[p].size()); rv)
+							resolved[p].push_back(std::move(item));
+						else if (policy == DuplicatePolicy::KeepLast)
+							resolved[p][position->second].second = std::move(item.second);
+						else if ((policy == DuplicatePolicy::Fail) && !errors[p])
+							errors[p] = std::make_exception_ptr(std::invalid_argument(std::format("bulkLoad - Duplicate key:{}", item.first)));
+					}
+				}
+			});
+			for (auto& error : errors)
+				if (error) std::rethrow_exception(error);
+
+			return applyBatch(resolved, policy);
+		}
+
+		/// @brief Opt-in crash safety: replays the journal at path into the container and then records every
+		/// successful add and remove in it. Records are made durable by a background group commit (one fdatasync per
+		/// batch); with JournalOptions::waitForDurability the mutating calls return once their record is durable.
+		/// A mutation whose record fails to become durable is reverted (unless a later mutation replaced the key) and
+		/// the call throws; once the journal failed every mutation throws before it is applied.
+		/// saveSnapshot checkpoints the journal so that it only holds the records written since the last image.
+		/// Invoke at startup, after loadSnapshot if one is used, before the container is shared.
+		/// @param path The journal file; created if missing
+		/// @param codec Encodes the StorageType; defaults to DefaultCodec<StorageType>
+		/// @param options Flush interval, batch size and whether callers wait for durability
+		/// @param keyCodec Encodes the KeyType; defaults to DefaultCodec<KeyType>
+		/// @return The number of journal records replayed
+		template <class ValueCodec = DefaultCodec<StorageType>, class KeyCodec = DefaultCodec<KeyType>>
+			requires Codec<ValueCodec, StorageType> && Codec<KeyCodec, KeyType>
+		uint64_t enableJournal(const std::filesystem::path& path,
+		                       const ValueCodec&            codec    = {},
+		                       JournalOptions               options  = {},
+		                       const KeyCodec&              keyCodec = {})
 		{
 			std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex);
 
-			// Search for any existing item..
-			if (auto item = _container.find(key); item != _container.end())
+			if (_journal) throw std::runtime_error(std::format("{} - Journal is already enabled", __FUNCTION__));
+
+			// The journal hands the existing records over while it opens so that the file is read once
+			auto& container = writable();
+			auto  journal   = std::make_unique<Journal>(path, options, [&](std::string_view record) {
+				uint8_t  op {0};
+				uint32_t keyBytes {0};
+				if (record.size() < sizeof(op) + sizeof(keyBytes)) return;
+				std::memcpy(&op, record.data(), sizeof(op));
+				std::memcpy(&keyBytes, record.data() + sizeof(op), sizeof(keyBytes));
+				record.remove_prefix(sizeof(op) + sizeof(keyBytes));
+				if (record.size() < keyBytes) return;
+
+				auto key = keyCodec.decode(record.substr(0, keyBytes));
+				if (static_cast<ChangeOp>(op) == ChangeOp::Remove)
+				{
+					updateIndexes(key, {});
+					container.erase(key);
+				}
+				else
+				{
+					auto value = std::make_shared<StorageType>(codec.decode(record.substr(keyBytes)));
+					updateIndexes(key, value);
+					container.insert_or_assign(std::move(key), std::move(value));
+				}
+			});
+
+			_journalEncode = [codec, keyCodec](ChangeOp op, const KeyType& key, const StorageTypePtr& value) {
+				std::string encodedKey = keyCodec.encode(key);
+				auto        keyBytes   = static_cast<uint32_t>(encodedKey.size());
+				std::string record {};
+				record.push_back(static_cast<char>(op));
+				record.append(reinterpret_cast<const char*>(&keyBytes), sizeof(keyBytes));
+				record.append(encodedKey);
+				if (value) record.append(codec.encode(*value));
+				return record;
+			};
+			_journalOptions = options;
+			_journal        = std::move(journal);
+
+			return _journal->appendedLsn();
+		}
+
+
+		/// @brief Blocks until every journaled mutation so far is durable; use with waitForDurability=false.
+		/// @return false if there is no journal or the journal failed to write
+		bool flushJournal() { return _journal && _journal->flush(); }
+
+		/// @brief Handle returned by registerIndex; pass it to findBy and findAllBy of the same container.
+		/// @tparam IndexValue The result of the index projection
+		template <class IndexValue>
+		class IndexId
+		{
+		private:
+			friend class RWLContainer;
+
+			explicit IndexId(size_t slot)
+				: _slot(slot)
 			{
-				auto retItem = item->second;
+			}
 
-				_container.erase(item);
-				_counterRemoves++;
+			size_t _slot {0};
+		};
+
+
+		/// @brief Handle returned by registerColumn; pass it to scanWhere of the same container.
+		/// @tparam ColumnValue The result of the column projection
+		template <class ColumnValue>
+		class ColumnId
+		{
+		private:
+			friend class RWLContainer;
 
-				return retItem;
+			explicit ColumnId(size_t slot)
+				: _slot(slot)
+			{
 			}
 
-			return {};
+			size_t _slot {0};
+		};
+
+
+		/// @brief Registers a secondary index so that values are found by a field other than the key in O(1).
+		/// The index is built from the current items and then kept in sync, under the writer lock, by every add,
+		/// replace and remove (including loadSnapshot, bulkLoad and journal replay). Register the indexes at startup,
+		/// before the container is shared. The projected field must not be modified in place.
+		/// @param projection Invoked with a const StorageType&; returns the indexed value (must be hashable)
+		/// @param unique When true an add which would give the projected value a second key throws std::invalid_argument
+		/// and leaves the container unchanged; bulkLoad and loadSnapshot reject the whole batch.
+		/// @return The handle for findBy and findAllBy
+		template <class Projection>
+		auto registerIndex(Projection&& projection, bool unique = false)
+		{
+			using IndexValue = std::decay_t<std::invoke_result_t<Projection&, const StorageType&>>;
+
+			std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex);
+
+			auto index = std::make_unique<SecondaryIndex<KeyType, StorageType, IndexValue>>(std::forward<Projection>(projection), unique);
+			for (const auto& [key, value] : *_container)
+			{
+				index->check(key, value);
+				index->insert(key, value);
+			}
+			_indexes.push_back(std::move(index));
+
+			return IndexId<IndexValue>(_indexes.size() - 1);
 		}
 
 
-		StorageTypePtr find(const KeyType& key)
+		/// @brief Finds an item by a secondary index
+		/// @param indexId Returned by registerIndex
+		/// @param indexValue The projected value to look up
+		/// @return An item whose projection equals indexValue (the only one for a unique index); empty if none
+		template <class IndexValue>
+		StorageTypePtr findBy(const IndexId<IndexValue>& indexId, const std::type_identity_t<IndexValue>& indexValue) const
 		{
 			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
 
-			if (auto item = _container.find(key); item != _container.end()) return item->second;
+			return indexAt<SecondaryIndex<KeyType, StorageType, IndexValue>>(indexId._slot).findFirst(indexValue);
+		}
 
-			return {};
+
+		/// @brief Finds every item whose projection equals indexValue; for non-unique indexes
+		/// @param indexId Returned by registerIndex
+		/// @param indexValue The projected value to look up
+		/// @return The matching items in no particular order
+		template <class IndexValue>
+		std::vector<StorageTypePtr> findAllBy(const IndexId<IndexValue>& indexId, const std::type_identity_t<IndexValue>& indexValue) const
+		{
+			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
+
+			return indexAt<SecondaryIndex<KeyType, StorageType, IndexValue>>(indexId._slot).findAll(indexValue);
 		}
 
+		/// @brief Registers a columnar side index: a dense array of one numeric field of every value which
+		/// scanWhere filters at memory bandwidth instead of dereferencing each value. Like registerIndex it is built
+		/// from the current items and kept in sync by every mutation; register it at startup.
+		/// @param projection Invoked with a const StorageType&; returns an arithmetic value
+		/// @return The handle for scanWhere
+		template <class Projection>
+		auto registerColumn(Projection&& projection)
+		{
+			using ColumnValue = std::decay_t<std::invoke_result_t<Projection&, const StorageType&>>;
 
-		auto size() const
+			std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex);
+
+			auto column = std::make_unique<ColumnIndex<KeyType, StorageType, ColumnValue>>(std::forward<Projection>(projection));
+			for (const auto& [key, value] : *_container)
+				column->insert(key, value);
+			_indexes.push_back(std::move(column));
+
+			return ColumnId<ColumnValue>(_indexes.size() - 1);
+		}
+
+
+		/// @brief Scans the items whose column value satisfies the predicate. The predicate runs over the dense
+		/// column (vectorized for simple comparisons) and only the matching items are dereferenced.
+		/// WARNING! The callback is invoked within the reader lock!
+		/// @param columnId Returned by registerColumn
+		/// @param predicate bool(ColumnValue), for example [](int64_t v) { return v > 100; }
+		/// @param callback void(const KeyType&, const StorageTypePtr&) invoked for every match
+		/// @return The number of matching items
+		template <class ColumnValue, class Predicate, class Callback>
+		size_t scanWhere(const ColumnId<ColumnValue>& columnId, Predicate&& predicate, Callback&& callback) const
 		{
 			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
 
-			return _container.size();
+			return indexAt<ColumnIndex<KeyType, StorageType, ColumnValue>>(columnId._slot).scanWhere(predicate, callback);
 		}
 
+		/// @brief Read-only point-in-time view of an RWLContainer; see RWLContainer::snapshot.
+		/// Iterate and search it without any lock; the view never changes.
+		class Snapshot
+		{
+		public:
+			using const_iterator = typename StorageContainer::const_iterator;
+
+			Snapshot() = default;
+
+			auto begin() const { return _items->cbegin(); }
+			auto end() const { return _items->cend(); }
+			auto size() const { return _items->size(); }
+			bool empty() const { return _items->empty(); }
+
+			StorageTypePtr find(const KeyType& key) const
+			{
+				if (auto item = _items->find(key); item != _items->end()) return item->second;
+				return {};
+			}
+
+		private:
+			friend class RWLContainer;
 
-		StorageTypePtr scan(std::function<bool(const KeyType&, StorageTypePtr&)> scanCallback)
+			explicit Snapshot(std::shared_ptr<const StorageContainer> items)
+				: _items(std::move(items))
+			{
+			}
+
+			std::shared_ptr<const StorageContainer> _items {std::make_shared<const StorageContainer>()};
+		};
+
+
+		/// @brief Returns a consistent read-only view of the whole container in O(1) for long readers (analytics,
+		/// exports). The first mutation after a snapshot copies the container (copy-on-write) and the old version is
+		/// reclaimed once the last snapshot referring to it is released. With the default unordered_map backend that
+		/// copy is O(n) under the writer lock; the HamtMap backend copies only the path to the mutated entry.
+		/// @return Snapshot
+		Snapshot snapshot() const
 		{
 			std::shared_lock<std::shared_mutex> myReaderLock(_containerMutex);
 
-			for (auto& item : _container)
+			return Snapshot(_container);
+		}
+
+		/// @brief Streams every entry through the codecs to the sink in chunks of about chunkBytes, for admin dumps
+		/// of large containers. The entries are read from a snapshot() so no lock is held while encoding or writing;
+		/// memory use is bounded by the chunk size.
+		/// With the default unordered_map backend the first write during the export copies the whole map under the
+		/// writer lock (see snapshot), stalling readers and writers for O(n); use the HamtMap backend for containers
+		/// that are exported while busy.
+		/// @param sink Receives each chunk; see ExportWriter::toStream and ExportWriter::toFd
+		/// @param format ExportFormat::JsonLines or ExportFormat::Binary. JsonLines requires a value codec producing JSON
+		/// (see JsonCodec) and a key codec which is either StringCodec or a JsonTextCodec; otherwise std::invalid_argument
+		/// @param codec Encodes the StorageType
+		/// @param keyCodec Encodes the KeyType; defaults to DefaultCodec<KeyType>
+		/// @param chunkBytes Approximate size of the chunks handed to the sink
+		/// @return The number of entries written
+		template <class ValueCodec, class KeyCodec = DefaultCodec<KeyType>>
+			requires Codec<ValueCodec, StorageType> && Codec<KeyCodec, KeyType>
+		uint64_t exportTo(ExportWriter::Sink sink,
+		                  ExportFormat       format,
+		                  const ValueCodec&  codec      = {},
+		                  const KeyCodec&    keyCodec   = {},
+		                  size_t             chunkBytes = 64 * 1024) const
+		{
+			constexpr bool TextKeys = std::same_as<KeyCodec, StringCodec>;
+			constexpr bool JsonKeys = JsonTextCodec<KeyCodec>;
+			if constexpr (!TextKeys && !JsonKeys)
 			{
-				if (scanCallback(item.first, item.second)) return item.second;
+				// Binary key encodings would end up as escaped bytes inside a JSON string
+				if (format == ExportFormat::JsonLines)
+					throw std::invalid_argument(std::format("{} - JsonLines requires a StringCodec or JSON key codec", __FUNCTION__));
 			}
 
-			return {};
+			ExportWriter writer {std::move(sink), format, chunkBytes};
+
+			for (const auto& [key, value] : snapshot())
+			{
+				if constexpr (JsonKeys)
+					writer.writeJson(keyCodec.encode(key), codec.encode(*value));
+				else
+					writer.write(keyCodec.encode(key), codec.encode(*value));
+			}
+			writer.flush();
+
+			return writer.entries();
 		}
 
 #ifdef INCLUDE_NLOHMANN_JSON_HPP_
@@ -192,15 +671,335 @@ namespace siddiqsoft
 			                       {"removes", _counterRemoves.load()},
 			                       {"ReplaceExisting", ReplaceExisting},
 			                       {"FailOnCollission", FailOnCollission},
-			                       {"size", _container.size()}};
+			                       {"size", _container->size()},
+			                       {"copies", _counterCopies.load()},
+			                       {"changes", _changeFeed ? _changeFeed->head() : 0},
+			                       {"journalLsn", _journal ? _journal->durableLsn() : 0},
+			                       {"journalCommits", _journal ? _journal->commitCounter() : 0},
+			                       {"journalCheckpoints", _journal ? _journal->checkpointCounter() : 0},
+			                       {"indexes", _indexes.size()}};
 		}
 #endif
 
 	private:
-		StorageContainer          _container {};
+		using Batch = std::vector<std::pair<KeyType, StorageTypePtr>>;
+
+		/// @brief Implements bulkLoad and loadSnapshot: applies partitions of distinct keys as one unit.
+		/// An empty container is replaced by one built outside the lock; otherwise the items are merged under the lock.
+		/// Throws std::invalid_argument, before anything is applied, on an existing key with DuplicatePolicy::Fail or
+		/// on a unique index violation. Waits for the journal after releasing the lock.
+		/// @return The number of entries inserted or replaced
+		uint64_t applyBatch(std::vector<Batch>& partitions, DuplicatePolicy policy)
+		{
+			size_t itemCount {0};
+			for (auto& partition : partitions)
+				itemCount += partition.size();
+
+			std::shared_ptr<StorageContainer> built {};
+			if (size() == 0)
+			{
+				built = std::make_shared<StorageContainer>();
+				if constexpr (requires { built->reserve(size_t {}); }) built->reserve(itemCount);
+				for (auto& partition : partitions)
+					for (auto& [key, value] : partition)
+						built->insert_or_assign(std::move(key), std::move(value));
+			}
+
+			uint64_t loaded {0};
+			uint64_t lsn {0};
+			// (key, applied, previous) of every entry; kept only when a failed commit must be reverted
+			std::vector<std::tuple<KeyType, StorageTypePtr, StorageTypePtr>> undo {};
+			auto keepUndo = _journal && _journalOptions.waitForDurability;
+			if (std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex); true)
+			{
+				if (built && !_container->empty())
+				{
+					// A concurrent add got in first; merge the built items instead
+					partitions.assign(1, Batch(built->begin(), built->end()));
+					built.reset();
+				}
+
+				if (built)
+				{
+					checkIndexes([&](const auto& visit) {
+						for (const auto& [key, value] : *built)
+							visit(key, value);
+					});
+					if (_journal)
+						for (const auto& [key, value] : *built)
+							lsn = journalChange(ChangeOp::Insert, key, value);
+
+					_container = std::move(built);
+					for (const auto& [key, value] : *_container)
+					{
+						for (auto& index : _indexes)
+							index->insert(key, value);
+						feedChange(ChangeOp::Insert, key, value);
+						if (keepUndo) undo.emplace_back(key, value, nullptr);
+					}
+					loaded = _container->size();
+				}
+				else
+				{
+					for (auto& partition : partitions)
+					{
+						if (policy == DuplicatePolicy::Fail)
+						{
+							for (auto& item : partition)
+								if (_container->find(item.first) != _container->end())
+									throw std::invalid_argument(std::format("{} - Duplicate key:{}", __FUNCTION__, item.first));
+						}
+						else if (policy == DuplicatePolicy::KeepFirst)
+						{
+							std::erase_if(partition, [&](const auto& item) { return _container->find(item.first) != _container->end(); });
+						}
+					}
+					checkIndexes([&](const auto& visit) {
+						for (const auto& partition : partitions)
+							for (const auto& [key, value] : partition)
+								visit(key, value);
+					});
+					// The whole batch is journaled before any of it is applied
+					if (_journal)
+						for (const auto& partition : partitions)
+							for (const auto& [key, value] : partition)
+								lsn = journalChange(_container->contains(key) ? ChangeOp::Replace : ChangeOp::Insert, key, value);
+
+					auto& container = writable();
+					if constexpr (requires { container.reserve(size_t {}); }) container.reserve(container.size() + itemCount);
+					for (auto& partition : partitions)
+					{
+						for (auto& [key, value] : partition)
+						{
+							StorageTypePtr previous {};
+							if (keepUndo)
+								if (auto item = container.find(key); item != container.end()) previous = item->second;
+							applyIndexes(key, value);
+							auto [iter, rv] = container.insert_or_assign(std::move(key), std::move(value));
+							feedChange(rv ? ChangeOp::Insert : ChangeOp::Replace, iter->first, iter->second);
+							if (keepUndo) undo.emplace_back(iter->first, iter->second, std::move(previous));
+							loaded++;
+						}
+					}
+				}
+				_counterAdds += loaded;
+			}
+
+			// The journal commits in order so waiting for the last record covers the batch
+			awaitDurable(lsn, [&]() {
+				for (auto entry = undo.rbegin(); entry != undo.rend(); ++entry)
+					revert(std::get<0>(*entry), std::get<1>(*entry), std::get<2>(*entry));
+			});
+			return loaded;
+		}
+
+		/// @brief Runs task(0..count-1) on count threads and waits for them.
+		template <class Task>
+		static void parallelFor(size_t count, Task&& task)
+		{
+			if (count == 1) return task(0);
+
+			std::vector<std::jthread> workers {};
+			workers.reserve(count);
+			for (size_t i = 0; i < count; i++)
+				workers.emplace_back([&task, i]() { task(i); });
+		}
+
+		template <class Value>
+		static StorageTypePtr makeStorage(Value&& value)
+		{
+			if constexpr (std::is_convertible_v<Value, StorageTypePtr>)
+				return std::forward<Value>(value);
+			else
+				return std::make_shared<StorageType>(std::forward<Value>(value));
+		}
+
+		/// @brief Implements add: inserts the value from makeValue unless an existing item is kept or collides.
+		/// Waits for the journal (when enabled with waitForDurability) after releasing the lock.
+		template <class ValueFactory>
+		StorageTypePtr upsert(const KeyType& key, ValueFactory&& makeValue)
+		{
+			StorageTypePtr retItem {};
+			StorageTypePtr previous {};
+			uint64_t       lsn {0};
+
+			if (std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex); true)
+			{
+				// Search for any existing item..
+				auto itemFound = _container->find(key);
+				if (itemFound != _container->end() && FailOnCollission)
+					return {}; // collission but asked to fail
+				else if (itemFound != _container->end() && !FailOnCollission && !ReplaceExisting)
+					return itemFound->second; // found existing; return
+
+				// Item not found.. ReplaceExisting=> true and FailOnCollission=> false
+				auto value = makeValue();
+				auto op    = (itemFound != _container->end()) ? ChangeOp::Replace : ChangeOp::Insert;
+				if (itemFound != _container->end()) previous = itemFound->second;
+
+				// Validated and journaled first so that a failure rejects the add before it is applied
+				checkIndexes(key, value);
+				lsn = journalChange(op, key, value);
+				applyIndexes(key, value);
+
+				auto& container = writable();
+				auto [iter, rv] = container.insert_or_assign(key, std::move(value));
+				if (iter == container.end()) throw std::runtime_error(std::format("{} - Failed to add for key:{}", __FUNCTION__, key));
+
+				retItem = iter->second;
+				_counterAdds++;
+				feedChange(op, key, iter->second);
+			}
+
+			// Outside the lock so that concurrent writers share the group commit
+			awaitDurable(lsn, [&]() { revert(key, retItem, previous); });
+			return retItem;
+		}
+
+		/// @brief One partition per hardware thread (at most 64) but no more than one per 1024 items
+		static size_t snapshotPartitions(size_t itemCount)
+		{
+			return std::clamp<size_t>(std::min<size_t>(std::thread::hardware_concurrency(), itemCount / 1024), 1, 64);
+		}
+
+		/// @brief Must be invoked within the writer lock before mutating the container. Copies the container when a
+		/// snapshot still refers to it so that the snapshot remains unchanged (copy-on-write).
+		StorageContainer& writable()
+		{
+			// Snapshots are only taken under the reader lock so the count cannot grow while we hold the writer lock.
+			// It can drop concurrently: a snapshot released on another thread decrements it without our lock, and
+			// use_count() is a relaxed load. Observing 1 alone does not order that thread's last reads before our
+			// writes; the acquire fence pairs with the release of the decrement so in-place mutation is safe.
+			if (_container.use_count() > 1)
+			{
+				_container = std::make_shared<StorageContainer>(*_container);
+				_counterCopies++;
+			}
+			else
+			{
+				std::atomic_thread_fence(std::memory_order_acquire);
+			}
+			return *_container;
+		}
+
+		/// @brief Must be invoked within the writer lock before a validated mutation is applied.
+		/// Throws, leaving the mutation unapplied, once the journal failed.
+		/// @return The journal LSN of the mutation; zero when there is no journal
+		uint64_t journalChange(ChangeOp op, const KeyType& key, const StorageTypePtr& value)
+		{
+			if (_journal) return _journal->append(_journalEncode(op, key, value));
+			return 0;
+		}
+
+		/// @brief Must be invoked within the writer lock after a successful mutation
+		void feedChange(ChangeOp op, const KeyType& key, const StorageTypePtr& value)
+		{
+			if (_changeFeed) _changeFeed->append(op, key, value);
+		}
+
+		/// @brief Must be invoked within the writer lock. Restores previous (empty for absent) at key when the key
+		/// still holds applied, i.e. no later mutation replaced it. Used when the journal record of a mutation failed
+		/// to become durable; the reversal is published to the change feed but not journaled.
+		void revert(const KeyType& key, const StorageTypePtr& applied, const StorageTypePtr& previous)
+		{
+			auto           item = _container->find(key);
+			StorageTypePtr current {(item != _container->end()) ? item->second : StorageTypePtr {}};
+			if (current != applied) return;
+
+			applyIndexes(key, previous);
+			if (previous)
+			{
+				writable().insert_or_assign(key, previous);
+				feedChange(applied ? ChangeOp::Replace : ChangeOp::Insert, key, previous);
+			}
+			else
+			{
+				writable().erase(key);
+				feedChange(ChangeOp::Remove, key, {});
+			}
+		}
+
+		/// @brief Must be invoked within the writer lock before the item at key is set to value (empty for remove).
+		/// Throws when value violates a unique index so the container is unchanged; otherwise moves key from its
+		/// current value to value in every index.
+		void updateIndexes(const KeyType& key, const StorageTypePtr& value)
+		{
+			if (_indexes.empty()) return;
+
+			if (value) checkIndexes(key, value);
+
+			applyIndexes(key, value);
+		}
+
+		/// @brief Must be invoked within the writer lock. Throws when setting key to value would violate a unique index.
+		void checkIndexes(const KeyType& key, const StorageTypePtr& value)
+		{
+			for (auto& index : _indexes)
+				index->check(key, value);
+		}
+
+		/// @brief Must be invoked within the writer lock with a batch of distinct keys before it is applied.
+		/// Throws when applying the whole batch would violate a unique index.
+		void checkIndexes(const typename SecondaryIndexBase<KeyType, StorageType>::BatchVisitor& forEach)
+		{
+			for (auto& index : _indexes)
+				index->checkBatch(forEach);
+		}
+
+		/// @brief Like updateIndexes without the check; for batches validated by checkIndexes
+		void applyIndexes(const KeyType& key, const StorageTypePtr& value)
+		{
+			if (_indexes.empty()) return;
+
+			StorageTypePtr previous {};
+			if (auto item = _container->find(key); item != _container->end()) previous = item->second;
+
+			for (auto& index : _indexes)
+			{
+				if (previous) index->erase(key, previous);
+				if (value) index->insert(key, value);
+			}
+		}
+
+		/// @brief Returns the index or column registered at slot; IndexType is SecondaryIndex or ColumnIndex
+		template <class IndexType>
+		const IndexType& indexAt(size_t slot) const
+		{
+			if (slot >= _indexes.size()) throw std::out_of_range(std::format("{} - Unknown index:{}", __FUNCTION__, slot));
+
+			auto index = dynamic_cast<const IndexType*>(_indexes[slot].get());
+			if (!index) throw std::invalid_argument(std::format("{} - Index:{} belongs to another container", __FUNCTION__, slot));
+			return *index;
+		}
+
+		/// @brief Must be invoked outside the lock. When the record does not become durable the mutation is reverted
+		/// by undo under the writer lock and std::runtime_error is thrown.
+		template <class Undo>
+		void awaitDurable(uint64_t lsn, Undo&& undo)
+		{
+			if ((lsn == 0) || !_journalOptions.waitForDurability) return;
+			if (_journal->waitDurable(lsn)) return;
+
+			if (std::unique_lock<std::shared_mutex> myWriterLock(_containerMutex); true) undo();
+			throw std::runtime_error(std::format("{} - Journal write failed; lsn:{} is not durable and was reverted", __FUNCTION__, lsn));
+		}
+
+	private:
+		/// @brief Shared with the snapshots taken since the last mutation; see writable()
+		std::shared_ptr<StorageContainer> _container {std::make_shared<StorageContainer>()};
 		mutable std::shared_mutex _containerMutex {};
 		std::atomic_uint64_t      _counterAdds {};
 		std::atomic_uint64_t      _counterRemoves {};
+		std::atomic_uint64_t      _counterCopies {};
+		/// @brief Present once enableChangeFeed was invoked
+		std::unique_ptr<ChangeFeed<KeyType, StorageType>> _changeFeed {};
+		/// @brief Present once enableJournal was invoked
+		std::unique_ptr<Journal> _journal {};
+		JournalOptions           _journalOptions {};
+		/// @brief Encodes a mutation into a journal record: [u8 op][u32 keyBytes][key][value]
+		std::function<std::string(ChangeOp, const KeyType&, const StorageTypePtr&)> _journalEncode {};
+		/// @brief Secondary indexes and columns in the order of registration; see IndexId and ColumnId
+		std::vector<std::unique_ptr<SecondaryIndexBase<KeyType, StorageType>>> _indexes {};
 	};
 } // namespace siddiqsoft
 
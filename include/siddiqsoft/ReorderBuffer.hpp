@@ -0,0 +1,193 @@
+/*
+	Reorder buffer restoring sequence order
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef ReorderBuffer_HPP
+#define ReorderBuffer_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <semaphore>
+#include <type_traits>
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief ReorderBuffer. Bounded ring which accepts results completed out of order by parallel workers and
+	 *        releases them strictly in sequence order to a single downstream consumer.
+	 *        Workers publish into distinct slots without locking; a worker whose sequence is more than
+	 *        capacity ahead of the consumer blocks until the consumer catches up so memory stays bounded
+	 *        when one item is slow.
+	 *        Typically fed by WaitableQueue::tryWaitSequencedItem.
+	 *
+	 * @tparam StorageType Any move constructible object
+	 */
+	template <class StorageType>
+		requires std::is_move_constructible_v<StorageType>
+	class ReorderBuffer
+	{
+		static constexpr uint64_t EmptySlot = UINT64_MAX;
+
+		struct alignas(64) Slot
+		{
+			/// @brief Sequence of the value held in this slot
+			std::atomic_uint64_t       sequence {EmptySlot};
+			std::optional<StorageType> value {};
+		};
+
+	public:
+		ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+		ReorderBuffer(const ReorderBuffer&)            = delete;
+		ReorderBuffer(ReorderBuffer&&)                 = delete;
+		auto operator=(ReorderBuffer&&)                = delete;
+
+		/**
+		 * @brief Allocates the ring.
+		 *
+		 * @param capacity Maximum number of results held; rounded up to a power of two
+		 * @param firstSequence Sequence of the first result released
+		 */
+		explicit ReorderBuffer(size_t capacity = 1024, uint64_t firstSequence = 0)
+			: _next(firstSequence)
+		{
+			_capacity = 1;
+			while (_capacity < capacity)
+				_capacity <<= 1;
+			_slots = std::make_unique<Slot[]>(_capacity);
+		}
+
+		~ReorderBuffer() = default;
+
+		/**
+		 * @brief Stores the result for the given sequence. Blocks while the sequence is capacity or more ahead
+		 *        of the next sequence to be released. Each sequence must be completed exactly once.
+		 *
+		 * @param sequence The sequence assigned to the item when it was dequeued
+		 * @param value The result; ownership is transferred
+		 */
+		void complete(uint64_t sequence, StorageType&& value)
+		{
+			for (auto next = _next.load(std::memory_order_acquire); sequence >= (next + _capacity);
+			     next      = _next.load(std::memory_order_acquire))
+			{
+				_next.wait(next, std::memory_order_acquire);
+			}
+
+			auto& slot = _slots[sequence & (_capacity - 1)];
+			slot.value.emplace(std::move(value));
+			slot.sequence.store(sequence, std::memory_order_seq_cst);
+			_counterCompletes++;
+
+			// Wake the consumer only when it is parked on this very sequence; claiming the flag makes this the only wake
+			if ((_next.load(std::memory_order_seq_cst) == sequence) && _consumerWaiting.exchange(false, std::memory_order_seq_cst))
+				_signal.release();
+		}
+
+		/**
+		 * @brief Returns the next result in sequence order, waiting up to the specified interval for it to be completed.
+		 *        Only one thread may consume.
+		 *
+		 * @param timeoutDuration
+		 * @return std::optional<StorageType>
+		 */
+		[[nodiscard]] auto tryWaitItem(std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+				-> std::optional<StorageType>
+		{
+			std::optional<StorageType> item {};
+			auto                       deadline = std::chrono::steady_clock::now() + timeoutDuration;
+			auto                       next     = _next.load(std::memory_order_relaxed);
+			auto&                      slot     = _slots[next & (_capacity - 1)];
+
+			while (slot.sequence.load(std::memory_order_seq_cst) != next)
+			{
+				// Announce the park before the re-check so that a completer either sees the flag or we see its slot
+				_consumerWaiting.store(true, std::memory_order_seq_cst);
+				if (slot.sequence.load(std::memory_order_seq_cst) != next)
+				{
+					if (_signal.try_acquire_until(deadline)) continue;
+				}
+				// Done waiting: a completer which already claimed the flag releases exactly one permit which we consume
+				// here so that no stale permit is left for the next wait
+				if (!_consumerWaiting.exchange(false, std::memory_order_seq_cst)) _signal.acquire();
+				if (slot.sequence.load(std::memory_order_seq_cst) != next) return item;
+			}
+
+			item.emplace(std::move(*slot.value));
+			slot.value.reset();
+			_next.store(next + 1, std::memory_order_seq_cst);
+			// Release workers blocked on a full window
+			_next.notify_all();
+
+			return item;
+		}
+
+		/// @brief Returns the sequence of the next result to be released.
+		uint64_t nextSequence() const { return _next.load(std::memory_order_acquire); }
+
+		/// @brief Returns the number of results completed thus far.
+		auto completeCounter() -> uint64_t { return _counterCompletes; }
+
+		/// @brief Returns the maximum number of results held.
+		size_t capacity() const { return _capacity; }
+
+#ifdef INCLUDE_NLOHMANN_JSON_HPP_
+	public:
+		// If the JSON library is included in the current project, then make the serializer available.
+		nlohmann::json toJson()
+		{
+			return nlohmann::json {{"_typver", "ReorderBuffer/1.0.0"},
+			                       {"completes", _counterCompletes.load()},
+			                       {"next", nextSequence()},
+			                       {"capacity", _capacity}};
+		}
+#endif
+
+	private:
+		size_t                    _capacity {0};
+		std::unique_ptr<Slot[]>   _slots {};
+		/// @brief Sequence of the next result released to the consumer
+		alignas(64) std::atomic_uint64_t _next {0};
+		std::atomic_uint64_t      _counterCompletes {0};
+		/// @brief Set by the consumer while it is parked; the completer which clears it releases _signal
+		std::atomic_bool          _consumerWaiting {false};
+		std::binary_semaphore     _signal {0};
+	};
+} // namespace siddiqsoft
+
+#endif // !ReorderBuffer_HPP
@@ -0,0 +1,189 @@
+/*
+	Secondary indexes over RWLContainer values
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#pragma once
+#ifndef SecondaryIndex_HPP
+#define SecondaryIndex_HPP
+
+#include <format>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief Type-erased interface through which the container maintains its secondary indexes.
+	 *        Every method must be invoked while holding the container's writer lock.
+	 *
+	 * @tparam KeyType
+	 * @tparam StorageType
+	 */
+	template <class KeyType, class StorageType>
+	class SecondaryIndexBase
+	{
+	public:
+		using StorageTypePtr = std::shared_ptr<StorageType>;
+		/// @brief Invokes its argument with every (key, value) of a batch of distinct keys
+		using BatchVisitor = std::function<void(const std::function<void(const KeyType&, const StorageTypePtr&)>&)>;
+
+		virtual ~SecondaryIndexBase() = default;
+
+		/// @brief Throws std::invalid_argument when value would give a unique index a second key
+		virtual void check(const KeyType& key, const StorageTypePtr& value) const = 0;
+		/// @brief Throws std::invalid_argument when applying the whole batch would give a unique index a second key
+		virtual void checkBatch(const BatchVisitor& forEach) const = 0;
+		virtual void insert(const KeyType& key, const StorageTypePtr& value)      = 0;
+		virtual void erase(const KeyType& key, const StorageTypePtr& value)       = 0;
+	};
+
+
+	/**
+	 * @brief SecondaryIndex. Maps the projection of each value (for example a user's email) to the entries which
+	 *        hold it so they are found in O(1) without scanning the container.
+	 *        The entries keep the value pointer so a lookup does not go back to the container.
+	 *        The projected field must not be modified in place; replace the value in the container instead.
+	 *
+	 * @tparam KeyType
+	 * @tparam StorageType
+	 * @tparam IndexValue The result of the projection; must be hashable
+	 */
+	template <class KeyType, class StorageType, class IndexValue>
+	class SecondaryIndex : public SecondaryIndexBase<KeyType, StorageType>
+	{
+	public:
+		using StorageTypePtr = std::shared_ptr<StorageType>;
+		using Projection     = std::function<IndexValue(const StorageType&)>;
+
+		SecondaryIndex& operator=(const SecondaryIndex&) = delete;
+		SecondaryIndex(const SecondaryIndex&)            = delete;
+
+		/**
+		 * @brief Creates an empty index.
+		 *
+		 * @param projection Extracts the indexed field from a value
+		 * @param unique When true at most one key may hold any given projected value
+		 */
+		SecondaryIndex(Projection projection, bool unique)
+			: _projection(std::move(projection))
+			, _unique(unique)
+		{
+		}
+
+		void check(const KeyType& key, const StorageTypePtr& value) const override
+		{
+			if (!_unique) return;
+
+			// Replacing the value of the key which already holds the projected value is allowed
+			if (auto item = _entries.find(_projection(*value)); (item != _entries.end()) && (item->second.first != key))
+				throw std::invalid_argument(std::format("{} - Unique index violation; the value is already indexed for another key", __FUNCTION__));
+		}
+
+		void checkBatch(const typename SecondaryIndex::BatchVisitor& forEach) const override
+		{
+			if (!_unique) return;
+
+			// An indexed key which is part of the batch releases its value, so only the other keys can collide
+			std::unordered_set<KeyType> keys {};
+			forEach([&](const KeyType& key, const StorageTypePtr&) { keys.insert(key); });
+
+			std::unordered_set<IndexValue> claimed {};
+			forEach([&](const KeyType& key, const StorageTypePtr& value) {
+				auto indexValue = _projection(*value);
+				if (auto item = _entries.find(indexValue); (item != _entries.end()) && (item->second.first != key) && !keys.contains(item->second.first))
+					throw std::invalid_argument(std::format("{} - Unique index violation; the value is already indexed for another key", __FUNCTION__));
+				if (!claimed.insert(std::move(indexValue)).second)
+					throw std::invalid_argument(std::format("{} - Unique index violation; the value repeats within the batch", __FUNCTION__));
+			});
+		}
+
+		void insert(const KeyType& key, const StorageTypePtr& value) override
+		{
+			_entries.emplace(_projection(*value), std::make_pair(key, value));
+		}
+
+		void erase(const KeyType& key, const StorageTypePtr& value) override
+		{
+			auto [first, last] = _entries.equal_range(_projection(*value));
+			for (auto item = first; item != last; ++item)
+			{
+				if (item->second.first == key)
+				{
+					_entries.erase(item);
+					return;
+				}
+			}
+		}
+
+		/// @brief Returns an entry whose value projects to indexValue; empty when there is none
+		StorageTypePtr findFirst(const IndexValue& indexValue) const
+		{
+			if (auto item = _entries.find(indexValue); item != _entries.end()) return item->second.second;
+			return {};
+		}
+
+		/// @brief Returns every entry whose value projects to indexValue
+		std::vector<StorageTypePtr> findAll(const IndexValue& indexValue) const
+		{
+			std::vector<StorageTypePtr> values {};
+
+			auto [first, last] = _entries.equal_range(indexValue);
+			for (auto item = first; item != last; ++item)
+				values.push_back(item->second.second);
+
+			return values;
+		}
+
+		/// @brief Returns the number of indexed entries
+		size_t size() const { return _entries.size(); }
+
+		bool unique() const { return _unique; }
+
+	private:
+		Projection                                                              _projection;
+		bool                                                                    _unique {false};
+		std::unordered_multimap<IndexValue, std::pair<KeyType, StorageTypePtr>> _entries {};
+	};
+} // namespace siddiqsoft
+
+#endif // !SecondaryIndex_HPP
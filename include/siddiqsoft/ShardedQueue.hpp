@@ -0,0 +1,429 @@
+/*
+	Sharded queue with work stealing
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef ShardedQueue_HPP
+#define ShardedQueue_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "siddiqsoft/WaitableQueue.hpp"
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief The NUMA node of the calling thread as seen by ShardedQueue. Threads that are pinned by the client
+	 *        should bind() their node; otherwise the node of the CPU the thread is running on is detected and
+	 *        refreshed every RefreshInterval calls so that it follows a thread the scheduler migrated (Linux only,
+	 *        0 elsewhere).
+	 */
+	class ThreadNode
+	{
+	public:
+		/// @brief Number of current() calls between detections for unbound threads
+		static constexpr uint32_t RefreshInterval = 1024;
+
+		/// @brief Binds the calling thread to the given node for all ShardedQueue instances.
+		static void bind(size_t node) { slot() = {node, true, 1}; }
+
+		/// @brief Returns the node bound to the calling thread, or the recently detected node when unbound.
+		static size_t current()
+		{
+			auto& state = slot();
+			if (!state.bound && (state.calls++ % RefreshInterval == 0)) state.node = detect();
+			return state.node;
+		}
+
+		/// @brief Returns the node of the CPU the calling thread is currently running on.
+		static size_t detect()
+		{
+#if defined(__linux__) && defined(SYS_getcpu)
+			unsigned cpu {0}, node {0};
+			if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return node;
+#endif
+			return 0;
+		}
+
+	private:
+		struct State
+		{
+			size_t   node {0};
+			bool     bound {false};
+			uint32_t calls {0};
+		};
+
+		static State& slot()
+		{
+			thread_local State state {};
+			return state;
+		}
+	};
+
+
+	/**
+	 * @brief ShardedQueue. Scales a WaitableQueue across many cores by splitting it into up to 64 shards, each
+	 *        with its own lock on its own cache line. Every thread is bound to a home shard: producers push to
+	 *        their home shard and consumers pop from it, stealing a batch from another shard only when the
+	 *        home shard is empty. A single bitmap of non-empty shards drives both stealing and parking, and
+	 *        producers only touch the parking lock when a consumer is asleep.
+	 *        The shards may be partitioned across NUMA nodes: threads get a home shard on their ThreadNode and
+	 *        consumers steal from shards on their own node before crossing to a remote node. This partitioning is
+	 *        logical only; memory placement is left to the OS. The shard headers are allocated by the constructing
+	 *        thread and item storage by whichever thread grows a shard's deque, so pin the threads and construct the
+	 *        queue on a node's thread if placement matters.
+	 *        Ordering is FIFO per shard only.
+	 *
+	 * @tparam StorageType Any moveable object
+	 */
+	template <class StorageType>
+		requires Movable<StorageType>
+	class ShardedQueue
+	{
+		static constexpr size_t MaxShards  = 64;
+		static constexpr size_t StealBatch = 32;
+
+		struct alignas(64) Shard
+		{
+			std::mutex              mutex {};
+			std::deque<StorageType> items {};
+			/// @brief Mirrors items.size() for lock-free reads
+			std::atomic_size_t   depth {0};
+			std::atomic_uint64_t counterAdds {0};
+			/// @brief Items taken from this shard, by its own consumers or by stealing
+			std::atomic_uint64_t counterTakes {0};
+		};
+
+	public:
+		ShardedQueue& operator=(const ShardedQueue&) = delete;
+		ShardedQueue(const ShardedQueue&)            = delete;
+		ShardedQueue(ShardedQueue&&)                 = delete;
+		auto operator=(ShardedQueue&&)               = delete;
+
+		/**
+		 * @brief Allocates the shards.
+		 *
+		 * @param shardCount Number of shards; defaults to the number of hardware threads (maximum 64)
+		 * @param nodeCount Number of NUMA nodes the shards are split across; defaults to 1 (no affinity)
+		 */
+		explicit ShardedQueue(size_t shardCount = std::thread::hardware_concurrency(), size_t nodeCount = 1)
+			: _shardCount(std::clamp<size_t>(shardCount, 1, MaxShards))
+			, _nodeCount(std::clamp<size_t>(nodeCount, 1, _shardCount))
+			, _shards(std::make_unique<Shard[]>(_shardCount))
+		{
+			// Node N owns a contiguous range of shards
+			for (size_t node = 0; node < _nodeCount; node++)
+				for (size_t i = firstShard(node); i < firstShard(node + 1); i++)
+				{
+					_nodeMasks[node] |= uint64_t {1} << i;
+					_shardNodes[i] = node;
+				}
+		}
+
+		~ShardedQueue() = default;
+
+		/**
+		 * @brief Push item at the end of the calling thread's home shard and signals a sleeping consumer.
+		 *
+		 * @param value The client must std::move() the item if they wish to transfer ownership.
+		 */
+		void push(StorageType&& value) { emplaceInto(homeShard(), std::move(value)); }
+
+		/**
+		 * @brief Constructs the item in place at the end of the calling thread's home shard.
+		 *
+		 * @param args The arguments are forwarded to the constructor of StorageType
+		 */
+		template <class... Args>
+			requires std::constructible_from<StorageType, Args...>
+		void emplace(Args&&... args)
+		{
+			emplaceInto(homeShard(), std::forward<Args>(args)...);
+		}
+
+		/**
+		 * @brief Push item onto a shard owned by the given node so that consumers on that node take it first; use when the
+		 *        item was produced for another node. Any storage the push allocates is still allocated by the caller.
+		 *
+		 * @param node The node of the item
+		 * @param value The client must std::move() the item if they wish to transfer ownership.
+		 */
+		void pushToNode(size_t node, StorageType&& value) { emplaceInto(shardOnNode(node % _nodeCount), std::move(value)); }
+
+		/**
+		 * @brief Returns an item from the calling thread's home shard, stealing from other shards when it is empty,
+		 *        otherwise waits up to the specified interval for an item to become available.
+		 *
+		 * @param timeoutDuration
+		 * @return std::optional<StorageType>
+		 */
+		[[nodiscard]] auto tryWaitItem(std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+				-> std::optional<StorageType>
+		{
+			std::optional<StorageType> item {};
+			auto                       deadline = std::chrono::steady_clock::now() + timeoutDuration;
+			auto                       home     = homeShard();
+
+			auto                       local    = _nodeMasks[nodeOf(home)];
+
+			// Same-node shards are preferred; remote shards are only visited when the whole node is empty.
+			while (!takeFrom(home, item) && !steal(home, item, local) && !steal(home, item, ~local) && park(deadline))
+				;
+
+			return item;
+		}
+
+		/// @brief Returns the number of elements across all shards.
+		size_t size() const
+		{
+			size_t depth {0};
+			for (size_t i = 0; i < _shardCount; i++)
+				depth += _shards[i].depth.load(std::memory_order_acquire);
+			return depth;
+		}
+
+		/// @brief Returns the number of shards.
+		size_t shardCount() const { return _shardCount; }
+
+		/// @brief Returns the number of NUMA nodes the shards are split across.
+		size_t nodeCount() const { return _nodeCount; }
+
+		/// @brief Returns the number of elements added thus far.
+		auto addCounter() -> uint64_t
+		{
+			uint64_t adds {0};
+			for (size_t i = 0; i < _shardCount; i++)
+				adds += _shards[i].counterAdds.load(std::memory_order_relaxed);
+			return adds;
+		}
+
+		/// @brief Returns the number of times tryWaitItem resulted in a successful item retrieval.
+		auto removeCounter() -> uint64_t
+		{
+			uint64_t takes {0};
+			for (size_t i = 0; i < _shardCount; i++)
+				takes += _shards[i].counterTakes.load(std::memory_order_relaxed);
+			return takes;
+		}
+
+		/// @brief Returns the number of batches moved between shards by stealing consumers.
+		auto stealCounter() -> uint64_t { return _counterSteals.load(std::memory_order_relaxed); }
+
+		/// @brief Returns the number of batches stolen from a shard on another node.
+		auto remoteStealCounter() -> uint64_t { return _counterRemoteSteals.load(std::memory_order_relaxed); }
+
+#ifdef INCLUDE_NLOHMANN_JSON_HPP_
+	public:
+		// If the JSON library is included in the current project, then make the serializer available.
+		nlohmann::json toJson()
+		{
+			return nlohmann::json {{"_typver", "ShardedQueue/1.0.0"},
+			                       {"shards", _shardCount},
+			                       {"nodes", _nodeCount},
+			                       {"adds", addCounter()},
+			                       {"removes", removeCounter()},
+			                       {"steals", stealCounter()},
+			                       {"remoteSteals", remoteStealCounter()},
+			                       {"size", size()}};
+		}
+#endif
+
+	private:
+		/// @brief Threads are assigned home slots round robin on first use so that shards fill evenly.
+		static size_t threadSlot()
+		{
+			static std::atomic_size_t nextSlot {0};
+			thread_local size_t       slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+			return slot;
+		}
+
+		/// @brief The home shard of the calling thread lies on the thread's node.
+		size_t homeShard() const { return shardOnNode(ThreadNode::current() % _nodeCount); }
+
+		size_t shardOnNode(size_t node) const
+		{
+			auto first = firstShard(node);
+			return first + threadSlot() % (firstShard(node + 1) - first);
+		}
+
+		size_t firstShard(size_t node) const { return node * _shardCount / _nodeCount; }
+
+		size_t nodeOf(size_t index) const { return _shardNodes[index]; }
+
+		template <class... Args>
+		void emplaceInto(size_t index, Args&&... args)
+		{
+			auto& shard = _shards[index];
+
+			if (std::lock_guard<std::mutex> _ {shard.mutex}; true)
+			{
+				shard.items.emplace_back(std::forward<Args>(args)...);
+				shard.depth.fetch_add(1, std::memory_order_release);
+				shard.counterAdds.fetch_add(1, std::memory_order_relaxed);
+				if (shard.items.size() == 1) _nonEmpty.fetch_or(uint64_t {1} << index, std::memory_order_seq_cst);
+			}
+
+			wakeOne();
+		}
+
+		/// @brief Pops the front of the shard into item.
+		bool takeFrom(size_t index, std::optional<StorageType>& item)
+		{
+			// Cheap check before touching the shard lock
+			if ((_nonEmpty.load(std::memory_order_acquire) & (uint64_t {1} << index)) == 0) return false;
+
+			auto&                       shard = _shards[index];
+			std::lock_guard<std::mutex> _ {shard.mutex};
+
+			if (shard.items.empty()) return false;
+
+			item.emplace(std::move(shard.items.front()));
+			shard.items.pop_front();
+			shard.depth.fetch_sub(1, std::memory_order_release);
+			if (shard.items.empty()) _nonEmpty.fetch_and(~(uint64_t {1} << index), std::memory_order_seq_cst);
+			shard.counterTakes.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/// @brief Takes one item from the next non-empty shard within the mask and moves up to half of the victim's backlog home.
+		bool steal(size_t home, std::optional<StorageType>& item, uint64_t mask)
+		{
+			for (auto bitmap = _nonEmpty.load(std::memory_order_acquire) & mask; bitmap != 0;
+			     bitmap      = _nonEmpty.load(std::memory_order_acquire) & mask)
+			{
+				// Rotate so that each consumer starts looking just past its home shard
+				auto rotated = std::rotr(bitmap, static_cast<int>((home + 1) % MaxShards));
+				auto victim  = (static_cast<size_t>(std::countr_zero(rotated)) + home + 1) % MaxShards;
+				if (victim == home) return takeFrom(home, item);
+
+				std::vector<StorageType> batch {};
+				if (std::lock_guard<std::mutex> _ {_shards[victim].mutex}; true)
+				{
+					auto& shard = _shards[victim];
+					if (shard.items.empty()) continue;
+
+					auto count = std::clamp<size_t>(shard.items.size() / 2, 1, StealBatch);
+					batch.reserve(count);
+					for (size_t i = 0; i < count; i++)
+					{
+						batch.push_back(std::move(shard.items.front()));
+						shard.items.pop_front();
+					}
+					shard.depth.fetch_sub(count, std::memory_order_release);
+					shard.counterTakes.fetch_add(1, std::memory_order_relaxed);
+					if (shard.items.empty()) _nonEmpty.fetch_and(~(uint64_t {1} << victim), std::memory_order_seq_cst);
+				}
+
+				_counterSteals.fetch_add(1, std::memory_order_relaxed);
+				if (nodeOf(victim) != nodeOf(home)) _counterRemoteSteals.fetch_add(1, std::memory_order_relaxed);
+				item.emplace(std::move(batch.front()));
+
+				if (batch.size() > 1)
+				{
+					auto& shard = _shards[home];
+					if (std::lock_guard<std::mutex> _ {shard.mutex}; true)
+					{
+						for (size_t i = 1; i < batch.size(); i++)
+							shard.items.push_back(std::move(batch[i]));
+						shard.depth.fetch_add(batch.size() - 1, std::memory_order_release);
+						_nonEmpty.fetch_or(uint64_t {1} << home, std::memory_order_seq_cst);
+					}
+					wakeOne();
+				}
+				return true;
+			}
+
+			return false;
+		}
+
+		/// @brief Sleeps until some shard is non-empty or the deadline passes.
+		/// @return false when the deadline passed
+		bool park(std::chrono::steady_clock::time_point deadline)
+		{
+			std::unique_lock<std::mutex> lock(_parkMutex);
+
+			_sleepers.fetch_add(1, std::memory_order_seq_cst);
+			auto rc = _parkSignal.wait_until(lock, deadline, [&] { return _nonEmpty.load(std::memory_order_seq_cst) != 0; });
+			_sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+			return rc;
+		}
+
+		void wakeOne()
+		{
+			// Busy consumers never sleep so producers skip the parking lock entirely
+			if (_sleepers.load(std::memory_order_seq_cst) == 0) return;
+
+			std::lock_guard<std::mutex> _ {_parkMutex};
+			_parkSignal.notify_one();
+		}
+
+	private:
+		size_t                   _shardCount {1};
+		size_t                   _nodeCount {1};
+		std::unique_ptr<Shard[]> _shards {};
+		/// @brief Bit N of _nodeMasks[node] is set when shard N belongs to the node
+		std::array<uint64_t, MaxShards> _nodeMasks {};
+		/// @brief The node that owns each shard
+		std::array<size_t, MaxShards> _shardNodes {};
+		/// @brief Bit N is set while shard N holds items
+		alignas(64) std::atomic_uint64_t _nonEmpty {0};
+		alignas(64) std::atomic_uint32_t _sleepers {0};
+		std::mutex              _parkMutex {};
+		std::condition_variable _parkSignal {};
+		/// @brief Steals are rare so their counters are shared
+		alignas(64) std::atomic_uint64_t _counterSteals {0};
+		std::atomic_uint64_t _counterRemoteSteals {0};
+	};
+} // namespace siddiqsoft
+
+#endif // !ShardedQueue_HPP
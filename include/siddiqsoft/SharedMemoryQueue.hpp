@@ -0,0 +1,404 @@
+/*
+	Inter-process shared memory queue
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef SharedMemoryQueue_HPP
+#define SharedMemoryQueue_HPP
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief SharedMemoryQueue. Single-producer single-consumer ring of trivially copyable records living in
+	 *        a named POSIX shared memory region (/dev/shm on Linux) so that a producer process and a consumer
+	 *        process can exchange items without serialization or sockets. It is not zero-copy: push copies the
+	 *        record into its slot and tryWaitItem copies it out.
+	 *        The first process to open a name creates and initializes the region; later processes attach to it.
+	 *        A region whose creator died before initializing it is initialized by the next process to attach.
+	 *        The producer and consumer indices live in the region so a restarted process resumes where the
+	 *        previous one stopped: a producer that crashed mid-write never published the slot and a consumer
+	 *        that crashed mid-read gets the item again.
+	 *        Waiting uses a process-shared futex on Linux; other platforms fall back to a short sleep loop.
+	 *
+	 * @tparam StorageType Any trivially copyable type (use std::array<std::byte, N> for fixed-size byte records)
+	 * @tparam Capacity Number of slots; must be a power of two
+	 */
+	template <class StorageType, size_t Capacity = 1024>
+		requires std::is_trivially_copyable_v<StorageType> && (Capacity > 0) && ((Capacity & (Capacity - 1)) == 0)
+	class SharedMemoryQueue
+	{
+		static constexpr uint64_t RegionMagic   = 0x5257'4C53'484D'5131; // "RWLSHMQ1"
+		/// @brief The upper half of the magic while a process initializes the region; the lower half is its pid
+		static constexpr uint64_t ClaimMagic    = 0x5257'4C49'0000'0000; // "RWLI"
+		static constexpr uint32_t RegionVersion = 1;
+		static constexpr int      SpinCount     = 64;
+		/// @brief How long an attaching process waits for the creator to size and initialize the region
+		static constexpr auto CreatorTimeout = std::chrono::milliseconds(1000);
+
+		static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		              "SharedMemoryQueue requires address-free lock-free atomics");
+
+		struct Region
+		{
+			std::atomic<uint64_t> magic {0};
+			uint32_t              version {RegionVersion};
+			uint32_t              recordSize {sizeof(StorageType)};
+			uint64_t              capacity {Capacity};
+			/// @brief Next slot the producer writes; owned by the producer
+			alignas(64) std::atomic<uint64_t> tail {0};
+			/// @brief Futex word bumped by the producer when a consumer is parked
+			std::atomic<uint32_t> itemSignal {0};
+			std::atomic<uint32_t> consumerWaiting {0};
+			/// @brief Next slot the consumer reads; owned by the consumer
+			alignas(64) std::atomic<uint64_t> head {0};
+			/// @brief Futex word bumped by the consumer when the producer is parked on a full ring
+			std::atomic<uint32_t> spaceSignal {0};
+			std::atomic<uint32_t> producerWaiting {0};
+			alignas(64) StorageType slots[Capacity];
+		};
+
+	public:
+		SharedMemoryQueue& operator=(const SharedMemoryQueue&) = delete;
+		SharedMemoryQueue(const SharedMemoryQueue&)            = delete;
+		SharedMemoryQueue(SharedMemoryQueue&&)                 = delete;
+		auto operator=(SharedMemoryQueue&&)                    = delete;
+
+		/**
+		 * @brief Creates the named region or attaches to an existing one.
+		 *
+		 * @param name POSIX shared memory name; must start with a slash (e.g. "/myqueue")
+		 * @throws std::runtime_error when the region cannot be opened or has an incompatible layout
+		 */
+		explicit SharedMemoryQueue(const std::string& name)
+			: _name(name)
+		{
+			bool created = true;
+
+			_fd = ::shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (_fd < 0 && errno == EEXIST)
+			{
+				created = false;
+				_fd     = ::shm_open(_name.c_str(), O_RDWR, 0600);
+			}
+			if (_fd < 0) throw std::runtime_error(std::format("{} - shm_open failed for {} errno:{}", __func__, _name, errno));
+
+			if (created && ::ftruncate(_fd, sizeof(Region)) != 0)
+			{
+				::close(_fd);
+				throw std::runtime_error(std::format("{} - ftruncate failed for {} errno:{}", __func__, _name, errno));
+			}
+
+			if (!created)
+			{
+				// The creator may still be sizing the region
+				struct stat info {};
+				auto        deadline = std::chrono::steady_clock::now() + CreatorTimeout;
+				while ((::fstat(_fd, &info) == 0) && (info.st_size == 0) && (std::chrono::steady_clock::now() < deadline))
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				// The creator died before sizing it; the zero-filled region is claimed below like a fresh one
+				if ((info.st_size == 0) && (::ftruncate(_fd, sizeof(Region)) == 0)) info.st_size = sizeof(Region);
+				if (static_cast<size_t>(info.st_size) < sizeof(Region))
+				{
+					::close(_fd);
+					throw std::runtime_error(std::format("{} - Region {} has an incompatible size", __func__, _name));
+				}
+			}
+
+			auto mapped = ::mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+			if (mapped == MAP_FAILED)
+			{
+				::close(_fd);
+				throw std::runtime_error(std::format("{} - mmap failed for {} errno:{}", __func__, _name, errno));
+			}
+
+			// The region is zero-filled by ftruncate; it is initialized in place so that the magic is never reset
+			_region = static_cast<Region*>(mapped);
+			if (created)
+			{
+				tryInitialize(0);
+			}
+			else
+			{
+				auto magic = awaitInitialized();
+				// A claim whose owner is still alive is merely slow; only a dead owner's claim is taken over
+				if ((magic >> 32) == (ClaimMagic >> 32) && claimantAlive(magic)) magic = awaitInitialized();
+				if ((magic == 0) || ((magic >> 32) == (ClaimMagic >> 32)))
+				{
+					// The creator (or a previous rescuer) died before publishing the region
+					if (!tryInitialize(magic)) awaitInitialized();
+				}
+				recover();
+			}
+		}
+
+		/// @brief Unmaps the region. The region persists until unlink() is called.
+		~SharedMemoryQueue()
+		{
+			if (_region) ::munmap(_region, sizeof(Region));
+			if (_fd >= 0) ::close(_fd);
+		}
+
+		/// @brief Removes the named region; processes already attached keep their mapping.
+		static void unlink(const std::string& name) { ::shm_unlink(name.c_str()); }
+
+		/**
+		 * @brief Copies the item into the next slot and signals a parked consumer.
+		 *        Only one process/thread may push.
+		 *
+		 * @param value The item to publish
+		 * @param timeoutDuration How long to wait for space when the ring is full
+		 * @return true if the item was published; false on timeout
+		 */
+		bool push(const StorageType& value, std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+		{
+			auto deadline = std::chrono::steady_clock::now() + timeoutDuration;
+			auto tail     = _region->tail.load(std::memory_order_relaxed);
+
+			while ((tail - _region->head.load(std::memory_order_seq_cst)) >= Capacity)
+			{
+				if (!park(_region->spaceSignal, _region->producerWaiting, deadline, [&] {
+						return (tail - _region->head.load(std::memory_order_seq_cst)) < Capacity;
+					}))
+					return false;
+			}
+
+			std::memcpy(&_region->slots[tail & (Capacity - 1)], &value, sizeof(StorageType));
+			_region->tail.store(tail + 1, std::memory_order_seq_cst);
+
+			if (_region->consumerWaiting.load(std::memory_order_seq_cst)) wake(_region->itemSignal);
+			return true;
+		}
+
+		/**
+		 * @brief Returns an item immediately otherwise waits for the specified interval for the producer to publish one.
+		 *        Only one process/thread may consume.
+		 *
+		 * @param timeoutDuration
+		 * @return std::optional<StorageType>
+		 */
+		[[nodiscard]] auto tryWaitItem(std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+				-> std::optional<StorageType>
+		{
+			auto deadline = std::chrono::steady_clock::now() + timeoutDuration;
+			auto head     = _region->head.load(std::memory_order_relaxed);
+
+			while (_region->tail.load(std::memory_order_seq_cst) == head)
+			{
+				if (!park(_region->itemSignal, _region->consumerWaiting, deadline, [&] {
+						return _region->tail.load(std::memory_order_seq_cst) != head;
+					}))
+					return {};
+			}
+
+			std::optional<StorageType> item {std::in_place};
+			std::memcpy(&(*item), &_region->slots[head & (Capacity - 1)], sizeof(StorageType));
+			_region->head.store(head + 1, std::memory_order_seq_cst);
+
+			if (_region->producerWaiting.load(std::memory_order_seq_cst)) wake(_region->spaceSignal);
+			return item;
+		}
+
+		/// @brief Returns the number of items published but not yet consumed.
+		size_t size() const
+		{
+			return static_cast<size_t>(_region->tail.load(std::memory_order_acquire) - _region->head.load(std::memory_order_acquire));
+		}
+
+		/// @brief Returns the number of items published over the lifetime of the region.
+		auto addCounter() -> uint64_t { return _region->tail.load(std::memory_order_acquire); }
+
+		/// @brief Returns the number of items consumed over the lifetime of the region.
+		auto removeCounter() -> uint64_t { return _region->head.load(std::memory_order_acquire); }
+
+#ifdef INCLUDE_NLOHMANN_JSON_HPP_
+	public:
+		// If the JSON library is included in the current project, then make the serializer available.
+		nlohmann::json toJson()
+		{
+			return nlohmann::json {{"_typver", "SharedMemoryQueue/1.0.0"},
+			                       {"name", _name},
+			                       {"capacity", Capacity},
+			                       {"adds", addCounter()},
+			                       {"removes", removeCounter()},
+			                       {"size", size()}};
+		}
+#endif
+
+	private:
+		/// @brief Validates the layout of an existing region and repairs indices left behind by a crashed peer.
+		void recover()
+		{
+			if ((_region->magic.load(std::memory_order_acquire) != RegionMagic) || (_region->version != RegionVersion) ||
+			    (_region->recordSize != sizeof(StorageType)) || (_region->capacity != Capacity))
+			{
+				::munmap(_region, sizeof(Region));
+				::close(_fd);
+				_region = nullptr;
+				_fd     = -1;
+				throw std::runtime_error(std::format("{} - Region {} has an incompatible layout", __func__, _name));
+			}
+
+			// A torn index (head ahead of tail or more than a ring apart) cannot be trusted; discard the backlog.
+			auto tail = _region->tail.load();
+			auto head = _region->head.load();
+			if ((head > tail) || ((tail - head) > Capacity)) _region->head.store(tail);
+
+			// The parked flags are left alone since the peer may be alive and asleep; a flag left behind by a dead peer
+			// only costs the next operations a wake. Wake both sides so that a live peer re-checks the indices.
+			wake(_region->itemSignal);
+			wake(_region->spaceSignal);
+		}
+
+		/// @brief Waits up to CreatorTimeout for the region to be published.
+		/// @return The magic last observed
+		uint64_t awaitInitialized()
+		{
+			auto deadline = std::chrono::steady_clock::now() + CreatorTimeout;
+			auto magic    = _region->magic.load(std::memory_order_acquire);
+			for (; (magic != RegionMagic) && (std::chrono::steady_clock::now() < deadline); magic = _region->magic.load(std::memory_order_acquire))
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			return magic;
+		}
+
+		/// @brief True when the process named in the claim still exists
+		static bool claimantAlive(uint64_t magic)
+		{
+			auto pid = static_cast<pid_t>(magic & 0xFFFF'FFFF);
+			return (pid > 0) && ((::kill(pid, 0) == 0) || (errno == EPERM));
+		}
+
+		/// @brief Claims the region if its magic is still observed and initializes it.
+		/// @return false when another process claimed it first
+		bool tryInitialize(uint64_t observed)
+		{
+			if (!_region->magic.compare_exchange_strong(observed, ClaimMagic | static_cast<uint32_t>(::getpid()), std::memory_order_acq_rel))
+				return false;
+
+			_region->version    = RegionVersion;
+			_region->recordSize = sizeof(StorageType);
+			_region->capacity   = Capacity;
+			_region->tail.store(0, std::memory_order_relaxed);
+			_region->head.store(0, std::memory_order_relaxed);
+			_region->itemSignal.store(0, std::memory_order_relaxed);
+			_region->spaceSignal.store(0, std::memory_order_relaxed);
+			_region->consumerWaiting.store(0, std::memory_order_relaxed);
+			_region->producerWaiting.store(0, std::memory_order_relaxed);
+			_region->magic.store(RegionMagic, std::memory_order_release);
+			return true;
+		}
+
+		/// @brief Registers as a waiter on the futex word, re-checks the condition and sleeps until woken or deadline.
+		/// @return false when the deadline passed without the condition becoming true
+		template <class Predicate>
+		bool park(std::atomic<uint32_t>&                signal,
+		          std::atomic<uint32_t>&                waiting,
+		          std::chrono::steady_clock::time_point deadline,
+		          Predicate&&                           ready)
+		{
+			auto now = std::chrono::steady_clock::now();
+			if (now >= deadline) return false;
+
+			// The peer is usually mid-operation; a brief spin avoids a sleep/wake round trip through the kernel.
+			for (auto spin = 0; spin < SpinCount; spin++)
+			{
+				if (ready()) return true;
+				std::this_thread::yield();
+			}
+
+			auto observed = signal.load(std::memory_order_acquire);
+			waiting.store(1, std::memory_order_seq_cst);
+			if (!ready())
+			{
+#if defined(__linux__)
+				auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+				struct timespec timeout {
+					static_cast<time_t>(remaining.count() / 1'000'000'000), static_cast<long>(remaining.count() % 1'000'000'000)
+				};
+				::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&signal), FUTEX_WAIT, observed, &timeout, nullptr, 0);
+#else
+				for (auto spin = std::chrono::microseconds(50); (signal.load(std::memory_order_acquire) == observed) && !ready() &&
+				                                                (std::chrono::steady_clock::now() < deadline);
+				     spin = std::min(spin * 2, std::chrono::microseconds(1000)))
+					std::this_thread::sleep_for(spin);
+#endif
+			}
+			waiting.store(0, std::memory_order_seq_cst);
+			return true;
+		}
+
+		void wake(std::atomic<uint32_t>& signal)
+		{
+			signal.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+			::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&signal), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+		}
+
+	private:
+		std::string _name {};
+		int         _fd {-1};
+		Region*     _region {nullptr};
+	};
+} // namespace siddiqsoft
+
+#endif // __unix__ || __APPLE__
+
+#endif // !SharedMemoryQueue_HPP
@@ -0,0 +1,372 @@
+/*
+	Binary snapshot image for RWLContainer
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#pragma once
+#ifndef SnapshotFile_HPP
+#define SnapshotFile_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief SnapshotFile. Compact binary image of a key/value container used for warm restarts.
+	 *        Layout: header, partition table (offset, bytes, items per partition) and the partitions, each a run
+	 *        of records [u32 keyBytes][u32 valueBytes][key][value]. Items are hash-partitioned by the writer so
+	 *        the reader can decode the partitions in parallel. Integers are stored in native byte order.
+	 *        The partition table and every partition carry an FNV-1a checksum; a partition is verified before it
+	 *        is decoded so a corrupt image is rejected rather than loaded.
+	 *        The reader maps the file (POSIX) or reads it into memory (elsewhere).
+	 */
+	class SnapshotFile
+	{
+		static constexpr uint64_t Magic   = 0x31504e534c575200; // "\0RWLSNP1"
+		static constexpr uint32_t Version = 2;
+		/// @brief The smallest record: the two lengths
+		static constexpr uint64_t MinRecordBytes = 2 * sizeof(uint32_t);
+
+		struct Header
+		{
+			uint64_t magic {Magic};
+			uint32_t version {Version};
+			uint32_t partitions {0};
+			uint64_t items {0};
+			uint64_t tableChecksum {0};
+		};
+
+		struct Partition
+		{
+			uint64_t offset {0};
+			uint64_t bytes {0};
+			uint64_t items {0};
+			uint64_t checksum {0};
+		};
+
+	public:
+		/**
+		 * @brief Accumulates the records of one partition.
+		 */
+		struct PartitionWriter
+		{
+			std::string buffer {};
+			uint64_t    items {0};
+
+			void append(std::string_view key, std::string_view value)
+			{
+				uint32_t lengths[2] {static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size())};
+				buffer.append(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+				buffer.append(key);
+				buffer.append(value);
+				items++;
+			}
+		};
+
+		/**
+		 * @brief Writes the partitions to a temporary file which then replaces path so that readers never observe a
+		 *        partially written image. On POSIX the file is synced before the rename and the directory after it so
+		 *        that a crash leaves either the previous or the new image. Concurrent saves to the same path each use
+		 *        their own temporary file; the last rename wins.
+		 *
+		 * @param path Destination
+		 * @param partitions The encoded partitions
+		 * @throws std::runtime_error when the image cannot be written; the temporary file is removed
+		 */
+		static void write(const std::filesystem::path& path, const std::vector<PartitionWriter>& partitions)
+		{
+			Header                 header {};
+			std::vector<Partition> table(partitions.size());
+			uint64_t               offset = sizeof(Header) + sizeof(Partition) * partitions.size();
+
+			header.partitions = static_cast<uint32_t>(partitions.size());
+			for (size_t i = 0; i < partitions.size(); i++)
+			{
+				table[i] = {offset, partitions[i].buffer.size(), partitions[i].items, checksum(partitions[i].buffer)};
+				offset += partitions[i].buffer.size();
+				header.items += partitions[i].items;
+			}
+			header.tableChecksum = checksum({reinterpret_cast<const char*>(table.data()), sizeof(Partition) * table.size()});
+
+			auto temporary = temporaryPath(path);
+			try
+			{
+				writeFile(temporary, header, table, partitions);
+				std::filesystem::rename(temporary, path);
+			}
+			catch (...)
+			{
+				std::error_code ignored {};
+				std::filesystem::remove(temporary, ignored);
+				throw;
+			}
+			syncDirectory(path);
+		}
+
+		SnapshotFile& operator=(const SnapshotFile&) = delete;
+		SnapshotFile(const SnapshotFile&)            = delete;
+		SnapshotFile(SnapshotFile&&)                 = delete;
+		auto operator=(SnapshotFile&&)               = delete;
+
+		/**
+		 * @brief Maps the image and validates the header and partition table.
+		 *
+		 * @param path Source
+		 * @throws std::runtime_error when the file cannot be read or is not a valid image
+		 */
+		explicit SnapshotFile(const std::filesystem::path& path)
+		{
+			open(path);
+
+			if (_image.size() < sizeof(Header)) throw std::runtime_error(std::format("{} - {} is truncated", __FUNCTION__, path.string()));
+			std::memcpy(&_header, _image.data(), sizeof(Header));
+			if ((_header.magic != Magic) || (_header.version != Version))
+				throw std::runtime_error(std::format("{} - {} is not a snapshot image", __FUNCTION__, path.string()));
+			if (_image.size() < sizeof(Header) + sizeof(Partition) * uint64_t {_header.partitions})
+				throw std::runtime_error(std::format("{} - {} is truncated", __FUNCTION__, path.string()));
+
+			_table.resize(_header.partitions);
+			std::memcpy(_table.data(), _image.data() + sizeof(Header), sizeof(Partition) * _table.size());
+			if (checksum(_image.substr(sizeof(Header), sizeof(Partition) * _table.size())) != _header.tableChecksum)
+				throw std::runtime_error(std::format("{} - {} has a corrupt partition table", __FUNCTION__, path.string()));
+
+			uint64_t items {0};
+			for (const auto& partition : _table)
+			{
+				if ((partition.offset > _image.size()) || (partition.bytes > _image.size() - partition.offset) ||
+				    (partition.items > partition.bytes / MinRecordBytes))
+					throw std::runtime_error(std::format("{} - {} has an invalid partition table", __FUNCTION__, path.string()));
+				items += partition.items;
+			}
+			// The counts are used to presize the load
+			if (items != _header.items)
+				throw std::runtime_error(std::format("{} - {} has an invalid item count", __FUNCTION__, path.string()));
+		}
+
+		/// @brief Returns the number of partitions.
+		size_t partitionCount() const { return _table.size(); }
+
+		/// @brief Returns the total number of items.
+		uint64_t itemCount() const { return _header.items; }
+
+		/// @brief Returns the number of items in the partition.
+		uint64_t itemCount(size_t partition) const { return _table.at(partition).items; }
+
+		/**
+		 * @brief Verifies the checksum of the partition and invokes callback with the encoded key and value of every
+		 *        record in it. The views refer to the mapped image and are only valid during the callback.
+		 *
+		 * @throws std::runtime_error when the partition is corrupt or a record overruns it
+		 */
+		template <class Callback>
+		void forEach(size_t partition, Callback&& callback) const
+		{
+			const auto& entry = _table.at(partition);
+			auto        data  = _image.substr(entry.offset, entry.bytes);
+
+			if (checksum(data) != entry.checksum)
+				throw std::runtime_error(std::format("{} - Partition {} is corrupt", __FUNCTION__, partition));
+
+			for (uint64_t i = 0; i < entry.items; i++)
+			{
+				uint32_t lengths[2] {};
+				if (data.size() < sizeof(lengths))
+					throw std::runtime_error(std::format("{} - Partition {} is truncated", __FUNCTION__, partition));
+				std::memcpy(lengths, data.data(), sizeof(lengths));
+				data.remove_prefix(sizeof(lengths));
+				if (data.size() < uint64_t {lengths[0]} + lengths[1])
+					throw std::runtime_error(std::format("{} - Partition {} is truncated", __FUNCTION__, partition));
+
+				callback(data.substr(0, lengths[0]), data.substr(lengths[0], lengths[1]));
+				data.remove_prefix(uint64_t {lengths[0]} + lengths[1]);
+			}
+		}
+
+	private:
+		/// @brief FNV-1a (64 bit)
+		static uint64_t checksum(std::string_view bytes)
+		{
+			uint64_t hash {14695981039346656037ull};
+			for (auto c : bytes)
+				hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+			return hash;
+		}
+
+		/// @brief A name next to path which no other save (in this or another process) uses
+		static std::filesystem::path temporaryPath(const std::filesystem::path& path)
+		{
+			static const uint64_t        nonce = (uint64_t {std::random_device {}()} << 32) | std::random_device {}();
+			static std::atomic<uint64_t> sequence {0};
+
+			auto temporary = path;
+			temporary += std::format(".{:016x}.{}.tmp", nonce, sequence.fetch_add(1));
+			return temporary;
+		}
+
+		static void writeFile(const std::filesystem::path&        temporary,
+		                      const Header&                       header,
+		                      const std::vector<Partition>&       table,
+		                      const std::vector<PartitionWriter>& partitions)
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			auto fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+			if (fd < 0) throw std::runtime_error(std::format("{} - Failed to create {} errno:{}", __FUNCTION__, temporary.string(), errno));
+
+			auto writeAll = [fd](std::string_view bytes) {
+				while (!bytes.empty())
+				{
+					auto rc = ::write(fd, bytes.data(), bytes.size());
+					if (rc < 0 && errno == EINTR) continue;
+					if (rc < 0) return false;
+					bytes.remove_prefix(static_cast<size_t>(rc));
+				}
+				return true;
+			};
+
+			auto written = writeAll({reinterpret_cast<const char*>(&header), sizeof(header)}) &&
+			               writeAll({reinterpret_cast<const char*>(table.data()), sizeof(Partition) * table.size()});
+			for (size_t i = 0; written && (i < partitions.size()); i++)
+				written = writeAll(partitions[i].buffer);
+			// The data must be on disk before the rename makes it visible
+			written = written && (::fsync(fd) == 0);
+			auto error = errno;
+			::close(fd);
+			if (!written) throw std::runtime_error(std::format("{} - Failed to write {} errno:{}", __FUNCTION__, temporary.string(), error));
+#else
+			if (std::ofstream file {temporary, std::ios::binary | std::ios::trunc}; file)
+			{
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				file.write(reinterpret_cast<const char*>(table.data()), sizeof(Partition) * table.size());
+				for (const auto& partition : partitions)
+					file.write(partition.buffer.data(), partition.buffer.size());
+				if (!file.flush()) throw std::runtime_error(std::format("{} - Failed to write {}", __FUNCTION__, temporary.string()));
+			}
+			else
+			{
+				throw std::runtime_error(std::format("{} - Failed to create {}", __FUNCTION__, temporary.string()));
+			}
+#endif
+		}
+
+		/// @brief Persists the rename by syncing the directory entry (POSIX only).
+		static void syncDirectory(const std::filesystem::path& path)
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			auto directory = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+			auto fd        = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+			if (fd < 0) throw std::runtime_error(std::format("{} - Failed to open {} errno:{}", __FUNCTION__, directory.string(), errno));
+			auto synced = (::fsync(fd) == 0);
+			auto error  = errno;
+			::close(fd);
+			if (!synced) throw std::runtime_error(std::format("{} - Failed to sync {} errno:{}", __FUNCTION__, directory.string(), error));
+#endif
+		}
+
+		void open(const std::filesystem::path& path)
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			auto fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) throw std::runtime_error(std::format("{} - Failed to open {} errno:{}", __FUNCTION__, path.string(), errno));
+
+			struct stat info {};
+			if (::fstat(fd, &info) == 0 && info.st_size > 0)
+			{
+				auto mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapped != MAP_FAILED)
+				{
+					_mapping.address = mapped;
+					_mapping.bytes   = static_cast<size_t>(info.st_size);
+					_image           = std::string_view(static_cast<const char*>(mapped), static_cast<size_t>(info.st_size));
+					// Partitions are decoded front to back
+					::madvise(mapped, _image.size(), MADV_SEQUENTIAL);
+				}
+			}
+			::close(fd);
+			if (_mapping.address == nullptr) throw std::runtime_error(std::format("{} - Failed to map {}", __FUNCTION__, path.string()));
+#else
+			std::ifstream file {path, std::ios::binary};
+			if (!file) throw std::runtime_error(std::format("{} - Failed to open {}", __FUNCTION__, path.string()));
+			_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			_image = _buffer;
+#endif
+		}
+
+		/// @brief Owns the mapping so that it is released even when the constructor throws after mapping
+		struct Mapping
+		{
+			void*  address {nullptr};
+			size_t bytes {0};
+
+			Mapping()                          = default;
+			Mapping(const Mapping&)            = delete;
+			Mapping& operator=(const Mapping&) = delete;
+
+			~Mapping()
+			{
+#if defined(__unix__) || defined(__APPLE__)
+				if (address != nullptr) ::munmap(address, bytes);
+#endif
+			}
+		};
+
+	private:
+		Mapping                _mapping {};
+		Header                 _header {};
+		std::vector<Partition> _table {};
+		std::string_view       _image {};
+		std::string            _buffer {};
+	};
+} // namespace siddiqsoft
+
+#endif // !SnapshotFile_HPP
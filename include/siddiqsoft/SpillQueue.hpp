@@ -0,0 +1,350 @@
+/*
+	Disk spilling queue storage
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef SpillQueue_HPP
+#define SpillQueue_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "siddiqsoft/Codec.hpp"
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief Options controlling when and how a SpillQueue overflows to disk.
+	 */
+	struct SpillOptions
+	{
+		/// @brief Number of items kept in memory before new items are written to disk.
+		size_t maxItemsInMemory {65536};
+		/// @brief Estimated bytes kept in memory before new items are written to disk; 0 disables the check.
+		/// Measured by the codec's size(value) when it has one; otherwise sizeof(StorageType) plus the elements of
+		/// containers such as std::string. Other heap memory owned by the items is only counted via the codec.
+		size_t maxBytesInMemory {0};
+		/// @brief Encoded bytes accumulated before a single write is issued to the active segment.
+		size_t writeBatchBytes {256 * 1024};
+		/// @brief Size at which the active segment file is closed and a new one started.
+		size_t segmentBytes {64 * 1024 * 1024};
+		/// @brief Size of the read buffer used when draining a segment back into memory.
+		size_t readAheadBytes {1024 * 1024};
+		/// @brief Directory where segment files are created. Defaults to the system temp directory.
+		std::filesystem::path directory {};
+	};
+
+
+	/**
+	 * @brief SpillQueue. A FIFO container with the std::queue interface which keeps at most
+	 *        SpillOptions::maxItemsInMemory items in memory and serializes the overflow into
+	 *        append-only segment files. Use it as the StorageContainer of a WaitableQueue.
+	 *        Once spilling starts every new item goes to disk until the disk backlog is drained
+	 *        so that FIFO order is preserved.
+	 *        A segment which cannot be read back does not throw into the consumer: the unreadable backlog is
+	 *        discarded (see spillError and lostCounter) and the consumer's wait fails as if the queue were empty.
+	 *        Not thread-safe; the owning WaitableQueue provides the locking.
+	 *
+	 * @tparam StorageType Any moveable object
+	 * @tparam CodecType Converts StorageType to bytes and back; see siddiqsoft::Codec
+	 */
+	template <class StorageType, class CodecType = DefaultCodec<StorageType>>
+		requires Codec<CodecType, StorageType>
+	class SpillQueue
+	{
+		struct Segment
+		{
+			std::filesystem::path path {};
+			uint64_t              records {0};
+			uint64_t              recordsRead {0};
+			uint64_t              bytes {0};
+			uint64_t              readOffset {0};
+		};
+
+		/// @brief An in-memory item with the bytes it was accounted for; the item may be moved out before pop
+		struct Entry
+		{
+			StorageType value;
+			size_t      bytes {0};
+		};
+
+	public:
+		using value_type = StorageType;
+		using size_type  = size_t;
+
+		SpillQueue& operator=(const SpillQueue&) = delete;
+		SpillQueue(const SpillQueue&)            = delete;
+		SpillQueue(SpillQueue&&)                 = delete;
+		auto operator=(SpillQueue&&)             = delete;
+
+		SpillQueue()
+			: SpillQueue(SpillOptions {})
+		{
+		}
+
+		explicit SpillQueue(SpillOptions options, CodecType codec = {})
+			: _options(std::move(options))
+			, _codec(std::move(codec))
+		{
+			if (_options.maxItemsInMemory == 0) _options.maxItemsInMemory = 1;
+			if (_options.directory.empty()) _options.directory = std::filesystem::temp_directory_path();
+			_readBuffer.resize(_options.readAheadBytes);
+		}
+
+		/// @brief Removes any segment files still on disk.
+		~SpillQueue()
+		{
+			_writer.close();
+			_reader.close();
+			std::error_code ec;
+			for (auto& segment : _segments)
+				std::filesystem::remove(segment.path, ec);
+		}
+
+		void push(StorageType&& value)
+		{
+			if (_spilled == 0 && (_memory.empty() || withinMemoryLimits()))
+			{
+				auto bytes = itemBytes(value);
+				_memory.push_back({std::move(value), bytes});
+				_memoryBytes += bytes;
+			}
+			else
+			{
+				spill(value);
+			}
+		}
+
+		template <class... Args>
+		void emplace(Args&&... args)
+		{
+			if (_spilled == 0 && (_memory.empty() || withinMemoryLimits()))
+			{
+				auto& entry = _memory.emplace_back(Entry {StorageType(std::forward<Args>(args)...)});
+				entry.bytes = itemBytes(entry.value);
+				_memoryBytes += entry.bytes;
+			}
+			else
+			{
+				spill(StorageType(std::forward<Args>(args)...));
+			}
+		}
+
+		StorageType&       front() { return _memory.front().value; }
+		const StorageType& front() const { return _memory.front().value; }
+
+		/// @brief Removes the front item; reads the next batch from disk when the in-memory items are exhausted.
+		void pop() noexcept
+		{
+			// The recorded size; the owner usually moved the value out before popping it
+			_memoryBytes -= std::min(_memoryBytes, _memory.front().bytes);
+			_memory.pop_front();
+			if (_memory.empty() && _spilled > 0) refill();
+		}
+
+		[[nodiscard]] bool empty() const { return _memory.empty() && (_spilled == 0); }
+		size_t             size() const { return _memory.size() + _spilled; }
+
+		/// @brief Number of items currently held on disk.
+		size_t spilledCount() const { return _spilled; }
+
+		/// @brief Total number of items ever written to disk.
+		uint64_t spillCounter() const { return _counterSpills; }
+
+		/// @brief Number of spilled items discarded because their segment could not be read back.
+		uint64_t lostCounter() const { return _counterLost; }
+
+		/// @brief The last error reading a segment back; empty when none occurred.
+		const std::string& spillError() const { return _spillError; }
+
+	private:
+		bool withinMemoryLimits() const
+		{
+			return (_memory.size() < _options.maxItemsInMemory) &&
+			       ((_options.maxBytesInMemory == 0) || (_memoryBytes < _options.maxBytesInMemory));
+		}
+
+		/// @brief Uses the codec's size(value) when available otherwise sizeof(StorageType) plus the container elements
+		size_t itemBytes(const StorageType& value) const
+		{
+			if constexpr (requires { _codec.size(value); })
+				return static_cast<size_t>(_codec.size(value));
+			else if constexpr (requires { value.size(); typename StorageType::value_type; })
+				return sizeof(StorageType) + (value.size() * sizeof(typename StorageType::value_type));
+			else
+				return sizeof(StorageType);
+		}
+
+		void spill(const StorageType& value)
+		{
+			auto encoded = _codec.encode(value);
+			auto length  = static_cast<uint32_t>(encoded.size());
+
+			if (_segments.empty() || (_segments.back().bytes >= _options.segmentBytes))
+			{
+				flushWrites();
+				_writer.close();
+				_segments.push_back({_options.directory / std::format("rwlspill-{}-{}.seg", _instanceId, _segmentSequence++)});
+				_writer.open(_segments.back().path, std::ios::binary | std::ios::trunc);
+				if (!_writer) throw std::runtime_error(std::format("{} - Failed to create {}", __func__, _segments.back().path.string()));
+			}
+
+			_writeBuffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+			_writeBuffer.append(encoded);
+			_segments.back().records++;
+			_segments.back().bytes += sizeof(length) + length;
+			_spilled++;
+			_counterSpills++;
+
+			if (_writeBuffer.size() >= _options.writeBatchBytes) flushWrites();
+		}
+
+		/// @brief Issues a single write for all buffered records into the active segment
+		void flushWrites()
+		{
+			if (_writeBuffer.empty()) return;
+
+			_writer.write(_writeBuffer.data(), static_cast<std::streamsize>(_writeBuffer.size()));
+			_writer.flush();
+			if (!_writer) throw std::runtime_error(std::format("{} - Failed to write {}", __func__, _segments.back().path.string()));
+			_writeBuffer.clear();
+		}
+
+		/// @brief Reads up to maxItemsInMemory items from the oldest segments back into memory. Always reads at least
+		/// one item so that a single item larger than maxBytesInMemory does not stall the queue.
+		/// A read failure discards the backlog on disk; see spillError.
+		void refill() noexcept
+		{
+			try
+			{
+				readSegments();
+			}
+			catch (const std::exception& e)
+			{
+				_spillError = e.what();
+				_counterLost += _spilled;
+				_spilled = 0;
+			}
+
+			if (_spilled == 0)
+			{
+				// Disk backlog drained; return to in-memory operation and discard the last segment.
+				_writer.close();
+				_reader.close();
+				_writeBuffer.clear();
+				std::error_code ec;
+				for (auto& segment : _segments)
+					std::filesystem::remove(segment.path, ec);
+				_segments.clear();
+			}
+		}
+
+		void readSegments()
+		{
+			std::string payload;
+
+			while ((_spilled > 0) && (_memory.empty() || withinMemoryLimits()))
+			{
+				auto& segment = _segments.front();
+
+				if (segment.recordsRead == segment.records)
+				{
+					// Fully consumed; the active segment is never exhausted while items remain on disk.
+					_reader.close();
+					std::error_code ec;
+					std::filesystem::remove(segment.path, ec);
+					_segments.pop_front();
+					continue;
+				}
+
+				// Reading the segment we are still appending into requires the pending batch on disk
+				if (_segments.size() == 1) flushWrites();
+
+				if (!_reader.is_open())
+				{
+					_reader.rdbuf()->pubsetbuf(_readBuffer.data(), static_cast<std::streamsize>(_readBuffer.size()));
+					_reader.open(segment.path, std::ios::binary);
+				}
+				_reader.clear();
+				_reader.seekg(static_cast<std::streamoff>(segment.readOffset));
+
+				// Read as many records as the memory budget allows from this segment
+				while ((segment.recordsRead < segment.records) && (_memory.empty() || withinMemoryLimits()))
+				{
+					uint32_t length {0};
+					_reader.read(reinterpret_cast<char*>(&length), sizeof(length));
+					payload.resize(length);
+					_reader.read(payload.data(), length);
+					if (!_reader) throw std::runtime_error(std::format("{} - Failed to read {}", __func__, segment.path.string()));
+
+					auto& entry = _memory.emplace_back(Entry {_codec.decode(payload)});
+					entry.bytes = itemBytes(entry.value);
+					_memoryBytes += entry.bytes;
+					segment.recordsRead++;
+					segment.readOffset += sizeof(length) + length;
+					_spilled--;
+				}
+			}
+		}
+
+	private:
+		SpillOptions            _options {};
+		CodecType               _codec {};
+		std::deque<Entry>       _memory {};
+		size_t                  _memoryBytes {0};
+		size_t                  _spilled {0};
+		uint64_t                _counterSpills {0};
+		uint64_t                _counterLost {0};
+		std::string             _spillError {};
+		std::deque<Segment>     _segments {};
+		std::string             _writeBuffer {};
+		std::string             _readBuffer {};
+		std::ofstream           _writer {};
+		std::ifstream           _reader {};
+		uint64_t                _segmentSequence {0};
+		uint64_t _instanceId {static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+		                      reinterpret_cast<uintptr_t>(this)};
+	};
+} // namespace siddiqsoft
+
+#endif // !SpillQueue_HPP
@@ -0,0 +1,651 @@
+/*
+	Task queue with pooled completion handles
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#pragma once
+#ifndef TaskQueue_HPP
+#define TaskQueue_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "siddiqsoft/WaitableQueue.hpp"
+
+
+namespace siddiqsoft
+{
+	template <class R>
+	class TaskFuture;
+
+	class TaskQueue;
+
+
+	template <class Signature>
+	class TaskFunction;
+
+	/**
+	 * @brief Move-only callable holder for the work and continuation of a task. Callables of up to InlineBytes are
+	 *        stored inside the (pooled) task state so that submitting them does not allocate; larger ones fall back
+	 *        to the heap.
+	 *
+	 * @tparam R Result type
+	 */
+	template <class R>
+	class TaskFunction<R()>
+	{
+	public:
+		static constexpr size_t InlineBytes = 64;
+
+		TaskFunction() = default;
+		TaskFunction(const TaskFunction&)            = delete;
+		TaskFunction& operator=(const TaskFunction&) = delete;
+		TaskFunction(TaskFunction&& src) noexcept { *this = std::move(src); }
+		TaskFunction& operator=(TaskFunction&& src) noexcept
+		{
+			if (this != &src)
+			{
+				reset();
+				if (src._ops != nullptr)
+				{
+					src._ops->relocate(_storage, src._storage);
+					_ops = std::exchange(src._ops, nullptr);
+				}
+			}
+			return *this;
+		}
+		~TaskFunction() { reset(); }
+
+		template <class Fn>
+		void emplace(Fn&& fn)
+		{
+			using F = std::decay_t<Fn>;
+
+			reset();
+			if constexpr (fitsInline<F>())
+			{
+				::new (static_cast<void*>(_storage)) F(std::forward<Fn>(fn));
+				_ops = &InlineOps<F>;
+			}
+			else
+			{
+				*reinterpret_cast<F**>(_storage) = new F(std::forward<Fn>(fn));
+				_ops                             = &HeapOps<F>;
+			}
+		}
+
+		R operator()() { return _ops->invoke(_storage); }
+
+		explicit operator bool() const { return _ops != nullptr; }
+
+		void reset()
+		{
+			if (_ops != nullptr) std::exchange(_ops, nullptr)->destroy(_storage);
+		}
+
+	private:
+		struct Ops
+		{
+			R (*invoke)(void*);
+			void (*relocate)(void* target, void* source);
+			void (*destroy)(void*);
+		};
+
+		template <class F>
+		static constexpr bool fitsInline()
+		{
+			return (sizeof(F) <= InlineBytes) && (alignof(F) <= alignof(std::max_align_t)) && std::is_nothrow_move_constructible_v<F>;
+		}
+
+		template <class F>
+		static constexpr Ops InlineOps {
+				[](void* self) -> R { return (*std::launder(static_cast<F*>(self)))(); },
+				[](void* target, void* source) {
+					auto* from = std::launder(static_cast<F*>(source));
+					::new (target) F(std::move(*from));
+					from->~F();
+				},
+				[](void* self) { std::launder(static_cast<F*>(self))->~F(); }};
+
+		template <class F>
+		static constexpr Ops HeapOps {[](void* self) -> R { return (**static_cast<F**>(self))(); },
+		                              [](void* target, void* source) { *static_cast<F**>(target) = *static_cast<F**>(source); },
+		                              [](void* self) { delete *static_cast<F**>(self); }};
+
+		alignas(std::max_align_t) std::byte _storage[InlineBytes];
+		const Ops* _ops {nullptr};
+	};
+
+
+	/**
+	 * @brief Bounded lock-free multi-producer multi-consumer pool of idle objects (a ring with per-slot sequence
+	 *        numbers, so there is no ABA problem). Any thread returns an object and any thread takes one, so the
+	 *        states released by the workers feed the next submit on the client thread.
+	 *
+	 * @tparam T Owned type; deleted when the pool is destroyed
+	 * @tparam Capacity Power of two
+	 */
+	template <class T, size_t Capacity>
+		requires((Capacity & (Capacity - 1)) == 0)
+	class TaskStatePool
+	{
+		struct Slot
+		{
+			std::atomic_size_t sequence {0};
+			T*                 value {nullptr};
+		};
+
+	public:
+		TaskStatePool()
+		{
+			for (size_t i = 0; i < Capacity; i++)
+				_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		~TaskStatePool()
+		{
+			while (auto value = tryTake())
+				delete value;
+		}
+
+		/// @brief Returns false when the pool is full.
+		bool tryPut(T* value)
+		{
+			auto position = _putPosition.load(std::memory_order_relaxed);
+			while (true)
+			{
+				auto& slot     = _slots[position & (Capacity - 1)];
+				auto  sequence = slot.sequence.load(std::memory_order_acquire);
+				auto  lag      = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+				if (lag == 0)
+				{
+					if (_putPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						slot.value = value;
+						slot.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (lag < 0)
+					return false;
+				else
+					position = _putPosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		/// @brief Returns nullptr when the pool is empty.
+		T* tryTake()
+		{
+			auto position = _takePosition.load(std::memory_order_relaxed);
+			while (true)
+			{
+				auto& slot     = _slots[position & (Capacity - 1)];
+				auto  sequence = slot.sequence.load(std::memory_order_acquire);
+				auto  lag      = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+				if (lag == 0)
+				{
+					if (_takePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						auto value = slot.value;
+						slot.sequence.store(position + Capacity, std::memory_order_release);
+						return value;
+					}
+				}
+				else if (lag < 0)
+					return nullptr;
+				else
+					position = _takePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		alignas(64) std::atomic_size_t _putPosition {0};
+		alignas(64) std::atomic_size_t _takePosition {0};
+		std::array<Slot, Capacity> _slots {};
+	};
+
+
+	/**
+	 * @brief Shared state between a submitted task and its TaskFuture. Instances are recycled through a shared
+	 *        lock-free pool; completion is published through an atomic state machine (Pending -> Chained -> Ready)
+	 *        so that neither side takes a lock.
+	 */
+	class TaskStateBase
+	{
+	public:
+		virtual ~TaskStateBase() = default;
+
+		/// @brief Invoked by the worker thread; runs the work and completes the state.
+		virtual void execute() = 0;
+
+		/// @brief Drops a reference; the last reference returns the state to the pool.
+		virtual void release() = 0;
+	};
+
+
+	/**
+	 * @brief Result slot of a task returning R.
+	 *
+	 * @tparam R Result type; may be void
+	 */
+	template <class R>
+	class TaskState final : public TaskStateBase
+	{
+		template <class>
+		friend class TaskFuture;
+		friend class TaskQueue;
+
+		using ValueType = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+		static constexpr uint32_t Pending = 0;
+		/// @brief A continuation is installed; the completing thread must run it
+		static constexpr uint32_t Chained = 1;
+		static constexpr uint32_t Ready   = 2;
+		/// @brief Number of idle states kept for reuse
+		static constexpr size_t PoolLimit = 256;
+
+	public:
+		void execute() override
+		{
+			try
+			{
+				if constexpr (std::is_void_v<R>)
+				{
+					_work();
+					complete(std::monostate {});
+				}
+				else
+				{
+					complete(_work());
+				}
+			}
+			catch (...)
+			{
+				fail(std::current_exception());
+			}
+			_work.reset();
+			release();
+		}
+
+		void release() override
+		{
+			if (_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+			_value.reset();
+			_error = nullptr;
+			_work.reset();
+			_continuation.reset();
+			_state.store(Pending, std::memory_order_relaxed);
+
+			if (!freeList().tryPut(this)) delete this;
+		}
+
+		/// @brief Number of states handed out from the pool instead of being allocated.
+		static uint64_t poolHits() { return _counterPoolHits.load(std::memory_order_relaxed); }
+
+		/// @brief Number of states allocated because the pool was empty.
+		static uint64_t poolMisses() { return _counterPoolMisses.load(std::memory_order_relaxed); }
+
+	private:
+		/// @brief Returns a recycled (or new) state holding the given number of references.
+		static TaskState* acquire(uint32_t refs)
+		{
+			auto state = freeList().tryTake();
+
+			if (state != nullptr)
+			{
+				_counterPoolHits.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				state = new TaskState();
+				_counterPoolMisses.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			state->_refs.store(refs, std::memory_order_relaxed);
+			return state;
+		}
+
+		template <class V>
+		void complete(V&& value)
+		{
+			_value.emplace(std::forward<V>(value));
+			publish();
+		}
+
+		void fail(std::exception_ptr error)
+		{
+			_error = std::move(error);
+			publish();
+		}
+
+		/// @brief Marks the state Ready and runs the continuation inline when one was installed.
+		void publish()
+		{
+			if (_state.exchange(Ready, std::memory_order_acq_rel) == Chained)
+				_continuation();
+			else
+				_state.notify_all();
+		}
+
+		/// @brief Installs the continuation or runs it inline on the caller when the result is already available.
+		template <class Fn>
+		void chain(Fn&& continuation)
+		{
+			_continuation.emplace(std::forward<Fn>(continuation));
+			uint32_t expected = Pending;
+			if (!_state.compare_exchange_strong(expected, Chained, std::memory_order_acq_rel))
+			{
+				// The continuation may drop the last reference; it must not run from within this state
+				auto ready = std::move(_continuation);
+				ready();
+			}
+		}
+
+		void wait() const
+		{
+			for (auto state = _state.load(std::memory_order_acquire); state != Ready; state = _state.load(std::memory_order_acquire))
+				_state.wait(state, std::memory_order_acquire);
+		}
+
+		bool isReady() const { return _state.load(std::memory_order_acquire) == Ready; }
+
+		static TaskStatePool<TaskState, PoolLimit>& freeList()
+		{
+			static TaskStatePool<TaskState, PoolLimit> pool {};
+			return pool;
+		}
+
+	private:
+		std::atomic_uint32_t     _state {Pending};
+		std::atomic_uint32_t     _refs {0};
+		TaskFunction<R()>        _work {};
+		TaskFunction<void()>     _continuation {};
+		std::optional<ValueType> _value {};
+		std::exception_ptr       _error {};
+
+		static inline std::atomic_uint64_t _counterPoolHits {0};
+		static inline std::atomic_uint64_t _counterPoolMisses {0};
+	};
+
+
+	/// @brief Result type of a continuation passed to TaskFuture<R>::then
+	template <class Fn, class R>
+	struct TaskContinuationResult
+	{
+		using type = std::invoke_result_t<Fn, R>;
+	};
+
+	template <class Fn>
+	struct TaskContinuationResult<Fn, void>
+	{
+		using type = std::invoke_result_t<Fn>;
+	};
+
+
+	/**
+	 * @brief Lightweight completion handle returned by TaskQueue::submit. Move-only; waiting uses an atomic wait
+	 *        on the shared state (no mutex, no std::promise).
+	 *
+	 * @tparam R Result type; may be void
+	 */
+	template <class R>
+	class TaskFuture
+	{
+		friend class TaskQueue;
+		template <class>
+		friend class TaskFuture;
+
+	public:
+		TaskFuture() = default;
+		TaskFuture(const TaskFuture&)            = delete;
+		TaskFuture& operator=(const TaskFuture&) = delete;
+		TaskFuture(TaskFuture&& src) noexcept
+			: _state(std::exchange(src._state, nullptr))
+		{
+		}
+		TaskFuture& operator=(TaskFuture&& src) noexcept
+		{
+			if (this != &src)
+			{
+				if (_state != nullptr) _state->release();
+				_state = std::exchange(src._state, nullptr);
+			}
+			return *this;
+		}
+		~TaskFuture()
+		{
+			if (_state != nullptr) _state->release();
+		}
+
+		/// @brief Returns true while the future refers to a task whose result has not been consumed.
+		bool valid() const { return _state != nullptr; }
+
+		/// @brief Returns true once the task completed; never blocks.
+		bool isReady() const { return (_state != nullptr) && _state->isReady(); }
+
+		/// @brief Blocks until the task completed.
+		void wait() const
+		{
+			if (_state == nullptr) throw std::runtime_error("TaskFuture: no state");
+			_state->wait();
+		}
+
+		/**
+		 * @brief Blocks until the task completed and returns its result or rethrows its exception.
+		 *        Consumes the future.
+		 */
+		R get()
+		{
+			wait();
+
+			auto state = std::exchange(_state, nullptr);
+			struct Release
+			{
+				TaskState<R>* state;
+				~Release() { state->release(); }
+			} _ {state};
+
+			if (state->_error) std::rethrow_exception(state->_error);
+			if constexpr (!std::is_void_v<R>) return std::move(*state->_value);
+		}
+
+		/**
+		 * @brief Runs fn with the result on the thread which completes the task (inline on the worker), or
+		 *        immediately on the caller if the task already completed. Exceptions skip fn and propagate to the
+		 *        returned future. Consumes the future.
+		 *
+		 * @param fn Invoked with the result (no argument for void tasks)
+		 * @return TaskFuture for the result of fn
+		 */
+		template <class Fn>
+		auto then(Fn&& fn) && -> TaskFuture<typename TaskContinuationResult<Fn, R>::type>
+		{
+			using U = typename TaskContinuationResult<Fn, R>::type;
+
+			if (_state == nullptr) throw std::runtime_error("TaskFuture: no state");
+
+			auto  source = std::exchange(_state, nullptr);
+			auto* next   = TaskState<U>::acquire(2);
+
+			source->chain([source, next, fn = std::forward<Fn>(fn)]() mutable {
+				try
+				{
+					if (source->_error)
+						next->fail(source->_error);
+					else if constexpr (std::is_void_v<R> && std::is_void_v<U>)
+						fn(), next->complete(std::monostate {});
+					else if constexpr (std::is_void_v<R>)
+						next->complete(fn());
+					else if constexpr (std::is_void_v<U>)
+						fn(std::move(*source->_value)), next->complete(std::monostate {});
+					else
+						next->complete(fn(std::move(*source->_value)));
+				}
+				catch (...)
+				{
+					next->fail(std::current_exception());
+				}
+				next->release();
+				source->release();
+			});
+
+			return TaskFuture<U>(next);
+		}
+
+	private:
+		explicit TaskFuture(TaskState<R>* state)
+			: _state(state)
+		{
+		}
+
+		TaskState<R>* _state {nullptr};
+	};
+
+
+	/**
+	 * @brief TaskQueue. A pool of worker threads fed by a WaitableQueue. submit() returns a TaskFuture whose shared
+	 *        state (with small callables stored inline) is recycled through a shared lock-free pool so that
+	 *        steady-state submission allocates no promise, future, std::function or mutex.
+	 *        Continuations installed with TaskFuture::then run inline on the worker.
+	 *        The destructor completes every queued task before joining the workers.
+	 *        Object cannot be re-assigned, copied or moved as it owns its worker threads.
+	 */
+	class TaskQueue
+	{
+	public:
+		TaskQueue& operator=(const TaskQueue&) = delete;
+		TaskQueue(const TaskQueue&)            = delete;
+		TaskQueue(TaskQueue&&)                 = delete;
+		auto operator=(TaskQueue&&)            = delete;
+
+		/**
+		 * @brief Starts the worker threads.
+		 *
+		 * @param workerCount Defaults to the number of hardware threads
+		 */
+		explicit TaskQueue(size_t workerCount = std::thread::hardware_concurrency())
+		{
+			workerCount = std::max<size_t>(workerCount, 1);
+			_workers.reserve(workerCount);
+			for (size_t i = 0; i < workerCount; i++)
+				_workers.emplace_back([this](std::stop_token st) { run(st); });
+		}
+
+		~TaskQueue()
+		{
+			for (auto& worker : _workers)
+				worker.request_stop();
+			_workers.clear();
+		}
+
+		/**
+		 * @brief Queues fn for execution on a worker thread.
+		 *
+		 * @param fn Callable without arguments; its result or exception completes the returned future
+		 * @return TaskFuture<R>
+		 */
+		template <class Fn>
+			requires std::invocable<Fn>
+		[[nodiscard]] auto submit(Fn&& fn) -> TaskFuture<std::invoke_result_t<Fn>>
+		{
+			using R = std::invoke_result_t<Fn>;
+
+			// One reference for the queued task and one for the future
+			auto* state = TaskState<R>::acquire(2);
+			state->_work.emplace(std::forward<Fn>(fn));
+			_queue.push(state);
+
+			return TaskFuture<R>(state);
+		}
+
+		/// @brief Returns the number of tasks waiting for a worker.
+		size_t size() { return _queue.size(); }
+
+		/// @brief Returns the number of worker threads.
+		size_t workerCount() const { return _workers.size(); }
+
+		/// @brief Returns the number of tasks submitted thus far.
+		auto submitCounter() -> uint64_t { return _queue.addCounter(); }
+
+		/// @brief Returns the number of tasks executed thus far.
+		auto completeCounter() -> uint64_t { return _counterCompleted.load(std::memory_order_relaxed); }
+
+#ifdef INCLUDE_NLOHMANN_JSON_HPP_
+	public:
+		// If the JSON library is included in the current project, then make the serializer available.
+		nlohmann::json toJson()
+		{
+			return nlohmann::json {{"_typver", "TaskQueue/1.0.0"},
+			                       {"workers", workerCount()},
+			                       {"submitted", submitCounter()},
+			                       {"completed", completeCounter()},
+			                       {"size", size()}};
+		}
+#endif
+
+	private:
+		void run(std::stop_token st)
+		{
+			// Queued tasks are completed even after stop was requested
+			while (!st.stop_requested() || (_queue.size() > 0))
+			{
+				if (auto task = _queue.tryWaitItem(std::chrono::milliseconds(100)); task.has_value())
+				{
+					(*task)->execute();
+					_counterCompleted.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		}
+
+	private:
+		WaitableQueue<TaskStateBase*> _queue {};
+		std::atomic_uint64_t          _counterCompleted {0};
+		std::vector<std::jthread>     _workers {};
+	};
+} // namespace siddiqsoft
+
+#endif // !TaskQueue_HPP
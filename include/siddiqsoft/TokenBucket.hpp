@@ -0,0 +1,137 @@
+/*
+	Lock-free token bucket rate limiter
+
+	BSD 3-Clause License
+
+	Copyright (c) 2024, Siddiq Software LLC
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+#ifndef TokenBucket_HPP
+#define TokenBucket_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+
+namespace siddiqsoft
+{
+	/**
+	 * @brief TokenBucket. Lock-free rate limiter implemented as a generic cell rate algorithm: a single atomic
+	 *        "theoretical arrival time" is advanced by one interval per token. Up to `burst` tokens are available
+	 *        immediately after an idle period; afterwards tokens are spaced evenly at the configured rate.
+	 *        A default constructed (or zero rate) bucket is unlimited.
+	 */
+	class TokenBucket
+	{
+		using Clock = std::chrono::steady_clock;
+
+	public:
+		TokenBucket() = default;
+
+		TokenBucket(double tokensPerSecond, uint64_t burst) { configure(tokensPerSecond, burst); }
+
+		/**
+		 * @brief Changes the rate; safe to call while other threads reserve tokens.
+		 *
+		 * @param tokensPerSecond Zero or negative disables the limit
+		 * @param burst Number of tokens which may be taken back to back; minimum of 1
+		 */
+		void configure(double tokensPerSecond, uint64_t burst)
+		{
+			auto interval = (tokensPerSecond > 0) ? static_cast<int64_t>(1e9 / tokensPerSecond) : 0;
+			_interval.store(std::max<int64_t>(interval, (tokensPerSecond > 0) ? 1 : 0), std::memory_order_relaxed);
+			_tolerance.store(_interval.load(std::memory_order_relaxed) * static_cast<int64_t>(std::max<uint64_t>(burst, 1) - 1),
+			                 std::memory_order_relaxed);
+		}
+
+		/// @brief Returns true if the bucket limits the rate.
+		bool isLimited() const { return _interval.load(std::memory_order_relaxed) > 0; }
+
+		/**
+		 * @brief Reserves tokens. The caller must wait for the returned duration before using them.
+		 *        Nothing is reserved when the wait would exceed maxWait.
+		 *
+		 * @param count Number of tokens
+		 * @param maxWait Longest acceptable wait
+		 * @return std::optional<std::chrono::nanoseconds> The wait; empty if the tokens were not reserved
+		 */
+		std::optional<std::chrono::nanoseconds> reserve(uint64_t count = 1, std::chrono::nanoseconds maxWait = std::chrono::nanoseconds::max())
+		{
+			auto interval = _interval.load(std::memory_order_relaxed);
+			if ((interval == 0) || (count == 0)) return std::chrono::nanoseconds {0};
+
+			auto tolerance = _tolerance.load(std::memory_order_relaxed);
+			auto now       = Clock::now().time_since_epoch().count();
+			auto tat       = _tat.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				// The last of the tokens must conform: it may arrive at most `tolerance` early
+				auto start = std::max(tat, now);
+				auto wait  = std::max<int64_t>(start + interval * static_cast<int64_t>(count - 1) - tolerance - now, 0);
+				if (wait > maxWait.count()) return {};
+
+				if (_tat.compare_exchange_weak(tat, start + interval * static_cast<int64_t>(count), std::memory_order_relaxed))
+					return std::chrono::nanoseconds {wait};
+			}
+		}
+
+		/// @brief Takes a token if one is available right now.
+		bool tryAcquire() { return reserve(1, std::chrono::nanoseconds {0}).has_value(); }
+
+		/**
+		 * @brief Returns reserved tokens which were not used. The credit goes to the next reservation; it cannot
+		 *        exceed the burst since a reservation never starts before now.
+		 *
+		 * @param count Number of tokens
+		 */
+		void refund(uint64_t count = 1)
+		{
+			auto interval = _interval.load(std::memory_order_relaxed);
+			if ((interval == 0) || (count == 0)) return;
+
+			_tat.fetch_sub(interval * static_cast<int64_t>(count), std::memory_order_relaxed);
+		}
+
+	private:
+		/// @brief Nanoseconds between tokens; zero is unlimited
+		std::atomic_int64_t _interval {0};
+		/// @brief Nanoseconds of credit representing the burst
+		std::atomic_int64_t _tolerance {0};
+		/// @brief Theoretical arrival time of the next token in steady_clock nanoseconds
+		std::atomic_int64_t _tat {0};
+	};
+} // namespace siddiqsoft
+
+#endif // !TokenBucket_HPP
@@ -49,10 +49,15 @@
 #include <string>
 #include <atomic>
 #include <shared_mutex>
-#include <semaphore>
 #include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
+#include <semaphore>
 
-#include "siddiqsoft/RunOnEnd.hpp"
+#include "siddiqsoft/TokenBucket.hpp"
 
 
 namespace siddiqsoft
@@ -62,7 +67,30 @@ namespace siddiqsoft
 
 
 	/**
-	 * @brief WaitableQueue. Object cannot be re-assigned, copied or moved as it stores a shared_mutex and counting_semaphore.
+	 * @brief An item along with its position in the queue; see WaitableQueue::tryWaitSequencedItem
+	 */
+	template <typename T>
+	struct Sequenced
+	{
+		uint64_t sequence {0};
+		T        value;
+	};
+
+
+	/**
+	 * @brief Selects which parked consumer receives the next item; see WaitableQueue::setWakeOrder
+	 */
+	enum class WakeOrder
+	{
+		/// @brief The most recently parked consumer is woken first; its cache is warm and surplus consumers stay asleep
+		Lifo,
+		/// @brief The longest parked consumer is woken first
+		Fifo
+	};
+
+
+	/**
+	 * @brief WaitableQueue. Object cannot be re-assigned, copied or moved as it stores a shared_mutex and condition variables.
      *        Use this container in a multi-threaded scenario with workers processing IO from this queued list.
      *        Implementes a reader-writer lock to alleviate client burden.
      *        The client threads must deal with timeouts on empty queue.
@@ -78,6 +106,9 @@ namespace siddiqsoft
 		using RLock  = std::shared_lock<std::shared_mutex>;
 
 	public:
+		/// @brief Identifies a pushed item for cancel(); the ordinal of the add.
+		using Ticket = uint64_t;
+
 		/// @brief Disallow the copy assignment operator
 		WaitableQueue& operator=(const WaitableQueue&) = delete;
 		/// @brief Delete the copy constructor
@@ -90,6 +121,14 @@ namespace siddiqsoft
 		/// We must declare this as default since we're removing
 		/// the move and copy constructors.
 		WaitableQueue() = default;
+		/// @brief Forwards the arguments to the constructor of the StorageContainer.
+		/// Use this to configure containers such as SpillQueue.
+		template <class... ContainerArgs>
+			requires(sizeof...(ContainerArgs) > 0) && std::constructible_from<StorageContainer, ContainerArgs...>
+		explicit WaitableQueue(ContainerArgs&&... args)
+			: _container(std::forward<ContainerArgs>(args)...)
+		{
+		}
 		/// @brief Default destructor.
 		/// We must ask for the default destructor
 		~WaitableQueue() = default;
@@ -98,32 +137,116 @@ namespace siddiqsoft
 		 * @brief Push item at the end of the internal queue and signals waiting clients.
 		 * 
 		 * @param value The parameter is forwarded into the queue. The client must std::move() the item if they wish to transfer ownership.
+		 * @return Ticket which may be used to cancel() the item while it is still queued
 		 */
-		void push(StorageType&& value)
+		Ticket push(StorageType&& value)
 		{
+			Ticket ticket {};
+
 			if (RWLock _ {_containerMutex}; true)
 			{
-				_counterAdds++;
+				ticket = _counterAdds++;
 				_container.push(std::forward<decltype(value)>(value));
+				_arrivals.push_back(std::chrono::steady_clock::now());
+				_peakSize  = std::max(_peakSize, liveSize());
+				_burstSize = std::max(_burstSize, _container.size());
+				maybeShrink();
+				wakeNextWaiter();
+				wakeBatchWaiter();
 			}
-			// Must be outside the lock!
-			_signal.release();
+
+			return ticket;
 		}
 
 		/**
-		 * @brief Calls the underlying emplace method to the queue within a lock.
+		 * @brief Constructs the item in place at the end of the internal queue within a lock and signals waiting clients.
 		 * 
-		 * @param value The parameter is forwarded to the emplace method on the queue
+		 * @param args The arguments are forwarded to the constructor of StorageType
+		 * @return Ticket which may be used to cancel() the item while it is still queued
 		 */
-		void emplace(StorageType&& value)
+		template <class... Args>
+			requires std::constructible_from<StorageType, Args...>
+		Ticket emplace(Args&&... args)
 		{
+			Ticket ticket {};
+
 			if (RWLock _ {_containerMutex}; true)
 			{
-				_counterAdds++;
-				_container.emplace(std::forward<decltype(value)>(value));
+				ticket = _counterAdds++;
+				_container.emplace(std::forward<Args>(args)...);
+				_arrivals.push_back(std::chrono::steady_clock::now());
+				_peakSize  = std::max(_peakSize, liveSize());
+				_burstSize = std::max(_burstSize, _container.size());
+				maybeShrink();
+				wakeNextWaiter();
+				wakeBatchWaiter();
+			}
+
+			return ticket;
+		}
+
+		/**
+		 * @brief Sets the order in which parked consumers are woken. The default is WakeOrder::Lifo.
+		 * 
+		 * @param order WakeOrder::Lifo or WakeOrder::Fifo
+		 */
+		void setWakeOrder(WakeOrder order)
+		{
+			RWLock _ {_containerMutex};
+			_wakeOrder = order;
+		}
+
+		/**
+		 * @brief Marks a queued item as cancelled in O(1). The item stays in the container as a tombstone and is
+		 *        discarded, without being returned, when it reaches the front.
+		 * 
+		 * @param ticket The value returned by push or emplace
+		 * @return true if the item was still queued and is now cancelled
+		 */
+		bool cancel(Ticket ticket)
+		{
+			RWLock _ {_containerMutex};
+
+			// Already removed or never issued
+			if ((ticket < _headTicket) || (ticket >= _counterAdds)) return false;
+
+			if (_cancelled.insert(ticket).second)
+			{
+				_counterCancels++;
+				return true;
 			}
-			// Must be outside the lock!
-			_signal.release();
+
+			return false;
+		}
+
+		/**
+		 * @brief Limits the rate at which items are handed out. Consumers wait (parked, not spinning) for a token
+		 *        before they take an item; a consumer whose timeout would expire first leaves the item for another
+		 *        consumer. A token whose item was taken by another consumer meanwhile is returned to the bucket.
+		 *        waitBatch clients reserve a token per item of the batch before taking any item.
+		 * 
+		 * @param itemsPerSecond Zero disables the limit (default)
+		 * @param burst Items which may be handed out back to back after an idle period
+		 */
+		void setRateLimit(double itemsPerSecond, uint64_t burst = 1) { _rateLimiter.configure(itemsPerSecond, burst); }
+
+		/**
+		 * @brief Releases the memory retained after a burst. Once the depth has stayed at or below lowWatermark for
+		 *        idlePeriod the remaining items are moved into a fresh container and the old one, with its peak
+		 *        allocation, is freed. Containers with shrink_to_fit() are asked to shrink in place instead.
+		 *        The depth is counted in items (tombstones included), not bytes. The check runs within push,
+		 *        emplace, tryWaitItem and waitBatch; there is no timer, so a queue which sees no calls at all keeps
+		 *        its memory until the next one.
+		 * 
+		 * @param lowWatermark Depth considered idle
+		 * @param idlePeriod Zero disables shrinking (default)
+		 */
+		void setShrinkPolicy(size_t lowWatermark, std::chrono::milliseconds idlePeriod)
+		{
+			RWLock _ {_containerMutex};
+			_shrinkWatermark = lowWatermark;
+			_shrinkAfter     = idlePeriod;
+			_lowSince        = {};
 		}
 
 		/**
@@ -139,7 +262,8 @@ namespace siddiqsoft
 			constexpr std::chrono::milliseconds spinInterval {32};
 			std::chrono::milliseconds           spinDuration {32};
 
-			while (!_container.empty() && (spinDuration < timeoutDuration))
+			// Tombstones left behind by cancel() do not count; they are only discarded when they reach the front
+			while ((size() > 0) && (spinDuration < timeoutDuration))
 			{
 				// Something is in the queue.. let's spinwait
 				std::this_thread::sleep_for(spinDuration);
@@ -159,33 +283,166 @@ namespace siddiqsoft
 		[[nodiscard]] auto tryWaitItem(std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
 				-> std::optional<StorageType>
 		{
-			// This will wait for the requested interval for an item to be
-			// ready for consumption. If available, we lock and attempt to
-			// pull an item.
-			// It is possible to be signalled and have the item potentially
-			// consumed by another thread (if you have multiple threads against
-			// this object.)
-			if (_signal.try_acquire_for(timeoutDuration))
+			std::optional<StorageType> item {};
+
+			waitAndTake(timeoutDuration, [&item](StorageType& front) { item.emplace(std::move(front)); });
+
+			// Single named return value so the compiler elides the copy (NRVO)
+			return item;
+		}
+
+		/**
+		 * @brief Same as tryWaitItem but also returns the ordinal of the item among the items taken by
+		 *        tryWaitSequencedItem (0 for the first). Hand the sequence to a ReorderBuffer to restore the original
+		 *        order after fanning items out to parallel workers. Items removed via tryWaitItem, waitBatch or
+		 *        drainAll, and cancelled items, do not consume sequence numbers so the sequence has no gaps.
+		 * 
+		 * @param timeoutDuration 
+		 * @return std::optional<Sequenced<StorageType>> 
+		 */
+		[[nodiscard]] auto tryWaitSequencedItem(std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+				-> std::optional<Sequenced<StorageType>>
+		{
+			std::optional<Sequenced<StorageType>> item {};
+
+			waitAndTake(timeoutDuration, [&item, this](StorageType& front) {
+				item.emplace(_counterSequenced, std::move(front));
+				_counterSequenced++;
+			});
+
+			return item;
+		}
+
+		/**
+		 * @brief Waits for a batch of items. Returns as soon as at least minItems are queued or once maxLinger has
+		 *        elapsed since the oldest queued item arrived, whichever comes first. The batch is removed under a
+		 *        single lock. Use this for consumers that perform best on batches (database writers, network sends).
+		 *        The linger period runs from the enqueue time of the item at the front, also after a partial batch or
+		 *        tryWaitItem removed the items before it. Each batch waiter registers its own minItems and producers
+		 *        wake a single batch waiter whose batch is complete; a waiter parked on an empty queue is additionally
+		 *        woken once by the first item when its linger period ends before its timeout.
+		 * 
+		 * @param minItems Number of items which completes the batch without waiting for the linger period
+		 * @param maxItems Upper bound on the number of items returned
+		 * @param maxLinger Longest time an item may wait for the batch to fill
+		 * @param timeoutDuration How long to wait for the first item; defaults to 100ms
+		 * @return std::vector<StorageType> Empty if no item arrived within the timeout
+		 */
+		[[nodiscard]] auto waitBatch(size_t                    minItems,
+		                             size_t                    maxItems,
+		                             std::chrono::milliseconds maxLinger,
+		                             std::chrono::milliseconds timeoutDuration = std::chrono::milliseconds(100))
+				-> std::vector<StorageType>
+		{
+			std::vector<StorageType> batch {};
+			auto                     timeoutAt = std::chrono::steady_clock::now() + timeoutDuration;
+
+			maxItems = std::max<size_t>(maxItems, 1);
+			minItems = std::clamp<size_t>(minItems, 1, maxItems);
+
+			uint64_t tokens {0};
+			if (RWLock lock {_containerMutex}; true)
 			{
-				if (RWLock _ {_containerMutex}; !_container.empty())
+				BatchWaiter self {minItems, maxLinger};
+				maybeShrink();
+
+				while (true)
 				{
-					// Using this scope guard allows us to minimize object movement
-					siddiqsoft::RunOnEnd scopeCleanup {[&]()
-					                                   {
-														   _container.pop();
-														   _counterRemoves++;
-													   }};
-					// Return the object with minimal copy
-					return std::make_optional(std::forward<StorageType>(_container.front()));
+					linkNode(_batchWaitersHead, _batchWaitersTail, self);
+					while (true)
+					{
+						skipCancelled();
+						if (liveSize() >= minItems) break;
+						// Once an item is queued the deadline is the end of its linger period
+						self.armed    = !_container.empty();
+						self.deadline = self.armed ? (_arrivals.front() + maxLinger) : timeoutAt;
+						if (std::chrono::steady_clock::now() >= self.deadline) break;
+						self.notified = false;
+						self.signal.wait_until(lock, self.deadline, [&self] { return self.notified; });
+					}
+					unlinkNode(_batchWaitersHead, _batchWaitersTail, self);
+
+					// Tokens are reserved before any item is taken so that no item is held while the batch is paced
+					if (!_rateLimiter.isLimited() || (liveSize() == 0)) break;
+					tokens = std::min(liveSize(), maxItems);
+					auto wait = _rateLimiter.reserve(tokens);
+					if (!wait || (wait->count() == 0)) break;
+
+					lock.unlock();
+					std::this_thread::sleep_for(*wait);
+					lock.lock();
+					skipCancelled();
+
+					// Other consumers may have taken the items meanwhile
+					if ((liveSize() > 0) || (std::chrono::steady_clock::now() >= timeoutAt)) break;
+					_rateLimiter.refund(tokens);
+					tokens = 0;
 				}
+
+				auto limit = (tokens > 0) ? tokens : maxItems;
+				batch.reserve(std::min(liveSize(), limit));
+				while (batch.size() < limit)
+				{
+					skipCancelled();
+					if (_container.empty()) break;
+					batch.push_back(std::move(_container.front()));
+					popFront();
+				}
+				_counterRemoves += batch.size();
+				// Starts the idle period once the batch left the queue low
+				maybeShrink();
+				// The remaining items may complete (or arm) the batch of another waiter
+				if (!_container.empty()) wakeBatchWaiter();
 			}
 
-			// empty
-			return {};
+			if (tokens > batch.size()) _rateLimiter.refund(tokens - batch.size());
+
+			return batch;
 		}
 
 		/**
-         * @brief Returns the number of elements in the queue.
+		 * @brief Removes every queued item by swapping the internal container with an empty one under a single lock.
+		 *        Use at shutdown or checkpoint boundaries instead of looping over tryWaitItem.
+		 *        Cancelled items are filtered out after the lock is released.
+		 * 
+		 * @return StorageContainer The items in FIFO order
+		 */
+		[[nodiscard]] auto drainAll() -> StorageContainer
+			requires std::default_initializable<StorageContainer> && std::swappable<StorageContainer>
+		{
+			StorageContainer           drained {};
+			std::unordered_set<Ticket> cancelled {};
+			Ticket                     firstTicket {0};
+			size_t                     count {0};
+
+			if (RWLock _ {_containerMutex}; true)
+			{
+				using std::swap;
+				swap(drained, _container);
+				swap(cancelled, _cancelled);
+				_arrivals.clear();
+				count       = drained.size();
+				firstTicket = _headTicket;
+				_headTicket += count;
+				_counterRemoves += count - cancelled.size();
+			}
+
+			if (!cancelled.empty())
+			{
+				StorageContainer live {};
+				for (auto ticket = firstTicket; !drained.empty(); ticket++)
+				{
+					if (!cancelled.contains(ticket)) live.push(std::move(drained.front()));
+					drained.pop();
+				}
+				return live;
+			}
+
+			return drained;
+		}
+
+		/**
+         * @brief Returns the number of elements in the queue excluding cancelled items.
          * 
          * @return auto 
          */
@@ -193,7 +450,7 @@ namespace siddiqsoft
 		{
 			RLock _ {_containerMutex};
 
-			return _container.size();
+			return liveSize();
 		}
 
 		/**
@@ -211,21 +468,282 @@ namespace siddiqsoft
 		 */
 		auto removeCounter() -> uint64_t { return _counterRemoves; }
 
+
+		/**
+		 * @brief Returns the number of items cancelled while queued.
+		 * 
+		 * @return uint64_t 
+		 */
+		auto cancelCounter() -> uint64_t { return _counterCancels; }
+
+
+		/**
+		 * @brief Returns the number of times the container was shrunk after a burst; see setShrinkPolicy.
+		 * 
+		 * @return uint64_t 
+		 */
+		auto shrinkCounter() -> uint64_t { return _counterShrinks; }
+
+
+		/**
+		 * @brief Returns the highest number of live items queued at once. This is a count of items; the memory
+		 *        held depends on the StorageType and the StorageContainer.
+		 * 
+		 * @return size_t 
+		 */
+		auto peakSize() -> size_t { return _peakSize; }
+
 #ifdef INCLUDE_NLOHMANN_JSON_HPP_
 	public:
 		// If the JSON library is included in the current project, then make the serializer available.
 		nlohmann::json toJson()
 		{
-			return nlohmann::json {{"_typver", "WaitableQueue/1.0.0"},
-			                       {"adds", _counterAdds},
-			                       {"removes", _counterRemoves},
-			                       {"size", _container.size()}};
+			nlohmann::json doc {{"_typver", "WaitableQueue/1.0.0"},
+			                    {"adds", _counterAdds},
+			                    {"removes", _counterRemoves},
+			                    {"cancels", _counterCancels},
+			                    {"shrinks", _counterShrinks},
+			                    {"peakSize", _peakSize},
+			                    {"size", liveSize()}};
+			if constexpr (requires { _container.spilledCount(); })
+			{
+				doc["spilled"]   = _container.spilledCount();
+				doc["spills"]    = _container.spillCounter();
+				doc["spillLost"] = _container.lostCounter();
+			}
+			return doc;
 		}
 #endif
 
 	private:
-		/// @brief Semaphore with default max signals.
-		std::counting_semaphore<> _signal {0};
+		/// @brief A consumer parked in waitAndTake. Lives on the stack of the consumer.
+		struct Waiter
+		{
+			std::binary_semaphore signal {0};
+			bool                  notified {false};
+			Waiter*               prev {nullptr};
+			Waiter*               next {nullptr};
+		};
+
+		/// @brief A client parked in waitBatch. Lives on the stack of the client.
+		struct BatchWaiter
+		{
+			size_t                                minItems {1};
+			std::chrono::milliseconds             linger {0};
+			/// @brief When the client wakes on its own: its timeout, or the end of the linger period once armed
+			std::chrono::steady_clock::time_point deadline {};
+			/// @brief True while the client waits for the linger period of a queued item
+			bool                                  armed {false};
+			bool                                  notified {false};
+			std::condition_variable_any           signal {};
+			BatchWaiter*                          prev {nullptr};
+			BatchWaiter*                          next {nullptr};
+		};
+
+		/**
+		 * @brief Waits for the requested interval for an item to be ready for consumption and hands the front to the
+		 *        callback which must move it out before it is popped.
+		 *        The queue is checked under the lock before parking; a parked consumer links a Waiter node into
+		 *        the waiter list so that producers only signal when someone is actually waiting and pick the
+		 *        consumer according to the WakeOrder.
+		 * 
+		 * @param timeoutDuration 
+		 * @param take Invoked within the lock with the front item
+		 */
+		template <class Callback>
+		void waitAndTake(std::chrono::milliseconds timeoutDuration, Callback&& take)
+		{
+			auto   deadline = std::chrono::steady_clock::now() + timeoutDuration;
+			bool   hasToken = !_rateLimiter.isLimited();
+			bool   reserved {false};
+			RWLock lock {_containerMutex};
+
+			maybeShrink();
+
+			while (true)
+			{
+				skipCancelled();
+
+				if (!_container.empty())
+				{
+					if (!hasToken)
+					{
+						// Park outside the lock until a token is available; leave the item for others if it would not arrive in time.
+						auto wait = _rateLimiter.reserve(
+								1, std::max<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now(), std::chrono::nanoseconds {0}));
+						if (!wait) return;
+						hasToken = reserved = true;
+						if (wait->count() > 0)
+						{
+							lock.unlock();
+							std::this_thread::sleep_for(*wait);
+							lock.lock();
+							// Another consumer may have taken the item meanwhile
+							continue;
+						}
+					}
+
+					// The front is popped only once the move succeeded.
+					take(_container.front());
+					popFront();
+					_counterRemoves++;
+					maybeShrink();
+					return;
+				}
+
+				if (std::chrono::steady_clock::now() >= deadline)
+				{
+					// The item we reserved a token for went to another consumer; give the token back
+					if (reserved) _rateLimiter.refund(1);
+					return;
+				}
+
+				// Park on our own node so that the producer decides who is woken.
+				Waiter self {};
+				linkNode(_waitersHead, _waitersTail, self);
+				lock.unlock();
+				bool signalled = self.signal.try_acquire_until(deadline);
+				lock.lock();
+				// A timed out waiter may have been picked before it re-acquired the lock; the item is then checked above.
+				if (!signalled && !self.notified) unlinkNode(_waitersHead, _waitersTail, self);
+			}
+		}
+
+		/// @brief Must be invoked within the lock. Number of queued items excluding tombstones.
+		size_t liveSize() const { return _container.size() - _cancelled.size(); }
+
+		/// @brief Must be invoked within the lock. Pops the front and advances the ticket of the front.
+		void popFront()
+		{
+			_container.pop();
+			_arrivals.pop_front();
+			_headTicket++;
+		}
+
+		/// @brief Must be invoked within the lock. Discards cancelled items at the front.
+		void skipCancelled()
+		{
+			while (!_cancelled.empty() && !_container.empty() && (_cancelled.erase(_headTicket) > 0))
+				popFront();
+		}
+
+		/// @brief Must be invoked within the lock. Replaces the container once the depth stayed low for the shrink period after a burst.
+		void maybeShrink()
+		{
+			if ((_shrinkAfter.count() == 0) || (_burstSize <= _shrinkWatermark)) return;
+
+			auto now = std::chrono::steady_clock::now();
+			if (_container.size() > _shrinkWatermark)
+			{
+				_lowSince = {};
+				return;
+			}
+			if (_lowSince == std::chrono::steady_clock::time_point {})
+			{
+				_lowSince = now;
+				return;
+			}
+			if ((now - _lowSince) < _shrinkAfter) return;
+
+			_arrivals.shrink_to_fit();
+			if constexpr (requires { _container.shrink_to_fit(); })
+			{
+				_container.shrink_to_fit();
+			}
+			else if constexpr (std::default_initializable<StorageContainer> && std::swappable<StorageContainer>)
+			{
+				// Tombstones are moved as well so that the tickets stay aligned with their positions.
+				StorageContainer fresh {};
+				for (; !_container.empty(); _container.pop())
+					fresh.push(std::move(_container.front()));
+				std::swap(_container, fresh);
+			}
+			else
+			{
+				_burstSize = 0;
+				return;
+			}
+			_burstSize = _container.size();
+			_lowSince  = {};
+			_counterShrinks++;
+		}
+
+		/// @brief Must be invoked within the lock. Appends the waiter to the tail of the waiter list.
+		template <class Node>
+		static void linkNode(Node*& head, Node*& tail, Node& waiter)
+		{
+			waiter.prev = tail;
+			if (tail != nullptr)
+				tail->next = &waiter;
+			else
+				head = &waiter;
+			tail = &waiter;
+		}
+
+		/// @brief Must be invoked within the lock. Removes the waiter from the waiter list.
+		template <class Node>
+		static void unlinkNode(Node*& head, Node*& tail, Node& waiter)
+		{
+			if (waiter.prev != nullptr)
+				waiter.prev->next = waiter.next;
+			else
+				head = waiter.next;
+			if (waiter.next != nullptr)
+				waiter.next->prev = waiter.prev;
+			else
+				tail = waiter.prev;
+			waiter.prev = waiter.next = nullptr;
+		}
+
+		/// @brief Must be invoked within the lock after an item was added. Hands the item to a single parked consumer.
+		/// The signal is released within the lock since the Waiter lives on the stack of the consumer.
+		void wakeNextWaiter()
+		{
+			Waiter* waiter = (_wakeOrder == WakeOrder::Lifo) ? _waitersTail : _waitersHead;
+			if (waiter == nullptr) return;
+			unlinkNode(_waitersHead, _waitersTail, *waiter);
+			waiter->notified = true;
+			waiter->signal.release();
+		}
+
+		/// @brief Must be invoked within the lock when items were added or left behind by a batch.
+		/// Wakes the first batch waiter whose minItems are queued. Failing that, and unless a waiter already waits for
+		/// the linger period of the queued items, the first waiter parked on an empty queue is woken to arm its timer
+		/// when that period ends before its timeout. The signal is sent within the lock since the BatchWaiter lives on
+		/// the stack of the client.
+		void wakeBatchWaiter()
+		{
+			BatchWaiter* idle {nullptr};
+			bool         armed {false};
+
+			for (auto waiter = _batchWaitersHead; waiter != nullptr; waiter = waiter->next)
+			{
+				// A notified waiter re-evaluates the queue once it runs
+				armed = armed || waiter->armed || waiter->notified;
+				if (waiter->notified) continue;
+				if (liveSize() >= waiter->minItems)
+				{
+					waiter->notified = true;
+					waiter->signal.notify_one();
+					return;
+				}
+				if ((idle == nullptr) && !waiter->armed && ((_arrivals.front() + waiter->linger) < waiter->deadline)) idle = waiter;
+			}
+
+			if (!armed && (idle != nullptr))
+			{
+				idle->notified = true;
+				idle->signal.notify_one();
+			}
+		}
+
+	private:
+		/// @brief Head of the list of consumers parked in waitAndTake; guarded by the _containerMutex
+		Waiter* _waitersHead {nullptr};
+		/// @brief Tail of the list of consumers parked in waitAndTake; the most recently parked
+		Waiter* _waitersTail {nullptr};
+		/// @brief Which end of the waiter list is woken first
+		WakeOrder _wakeOrder {WakeOrder::Lifo};
 		/// @brief The container (defaults to std::queue)
 		StorageContainer _container;
 		/// @brief The shared mutex used to perform reader-writer lock
@@ -234,6 +752,34 @@ namespace siddiqsoft
 		uint64_t _counterAdds {0};
 		/// @brief Tracks the total number of removes from the container
 		uint64_t _counterRemoves {0};
+		/// @brief Number of items handed out by tryWaitSequencedItem; the sequence of the next one
+		uint64_t _counterSequenced {0};
+		/// @brief Tracks the total number of cancelled items
+		uint64_t _counterCancels {0};
+		/// @brief Ticket of the item at the front of the container
+		Ticket _headTicket {0};
+		/// @brief Tickets of cancelled items still in the container (tombstones)
+		std::unordered_set<Ticket> _cancelled {};
+		/// @brief Paces consumers; unlimited by default
+		TokenBucket _rateLimiter {};
+		/// @brief Head of the list of clients parked in waitBatch; guarded by the _containerMutex
+		BatchWaiter* _batchWaitersHead {nullptr};
+		/// @brief Tail of the list of clients parked in waitBatch
+		BatchWaiter* _batchWaitersTail {nullptr};
+		/// @brief Enqueue time of every item in the container (tombstones included), front first
+		std::deque<std::chrono::steady_clock::time_point> _arrivals {};
+		/// @brief Highest number of live items queued at once
+		size_t _peakSize {0};
+		/// @brief Highest container depth since the last shrink
+		size_t _burstSize {0};
+		/// @brief Depth at or below which the queue is considered idle; see setShrinkPolicy
+		size_t _shrinkWatermark {0};
+		/// @brief How long the queue must stay idle before shrinking; zero disables shrinking
+		std::chrono::milliseconds _shrinkAfter {0};
+		/// @brief When the depth last dropped to the watermark; default while above it
+		std::chrono::steady_clock::time_point _lowSince {};
+		/// @brief Tracks the number of times the container was shrunk
+		uint64_t _counterShrinks {0};
 	};
 } // namespace siddiqsoft
 
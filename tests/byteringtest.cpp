@@ -0,0 +1,94 @@
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "../include/siddiqsoft/ByteRingQueue.hpp"
+
+
+TEST(ByteRingQueueTests, ReserveCommitPeekRelease)
+{
+	siddiqsoft::ByteRingQueue myContainer(256);
+
+	auto area = myContainer.reserve(32);
+	ASSERT_EQ(32, area.size());
+	// Write fewer bytes than reserved
+	std::memcpy(area.data(), "hello", 5);
+	myContainer.commit(5);
+	EXPECT_EQ(1, myContainer.addCounter());
+
+	auto view = myContainer.peek();
+	ASSERT_TRUE(view.has_value());
+	EXPECT_EQ("hello", *view);
+	myContainer.release();
+	EXPECT_EQ(0, myContainer.sizeBytes());
+
+	// Nothing left; peek times out
+	EXPECT_FALSE(myContainer.peek(std::chrono::milliseconds(1)).has_value());
+	// Records larger than half the ring are rejected
+	EXPECT_THROW((void)myContainer.reserve(myContainer.capacity()), std::length_error);
+	// Rings whose records would not fit the 32-bit length header are rejected before allocating
+	EXPECT_THROW(siddiqsoft::ByteRingQueue(size_t {8} * 1024 * 1024 * 1024), std::invalid_argument);
+}
+
+TEST(ByteRingQueueTests, WrapAroundFull)
+{
+	siddiqsoft::ByteRingQueue myContainer(128);
+
+	// Fill the ring until a push times out
+	auto count = 0;
+	while (myContainer.push(std::format("item:{}", count), std::chrono::milliseconds(1)))
+		count++;
+	EXPECT_GT(count, 0);
+
+	// Interleave consumption and production across many wraps with varying sizes
+	auto next = 0;
+	for (auto i = 0; i < 1000; i++)
+	{
+		auto view = myContainer.peek(std::chrono::milliseconds(0));
+		ASSERT_TRUE(view.has_value());
+		EXPECT_EQ(std::format("item:{}", next++), *view);
+		myContainer.release();
+		while (myContainer.push(std::format("item:{}", count), std::chrono::milliseconds(0)))
+			count++;
+	}
+	while (auto view = myContainer.peek(std::chrono::milliseconds(0)))
+	{
+		EXPECT_EQ(std::format("item:{}", next++), *view);
+		myContainer.release();
+	}
+	EXPECT_EQ(count, next);
+}
+
+TEST(ByteRingQueueTests, LoadTest_1)
+{
+	static const auto         ITERATION_COUNT = 910000;
+	siddiqsoft::ByteRingQueue myContainer(64 * 1024);
+
+	std::jthread producer([&]() {
+		for (auto i = 0; i < ITERATION_COUNT; i++)
+		{
+			auto value = std::format("Item---------------------------: {}", i);
+			while (!myContainer.push(value))
+				;
+		}
+	});
+
+	uint64_t itemCount = 0;
+	while (itemCount < ITERATION_COUNT)
+	{
+		auto view = myContainer.peek(std::chrono::milliseconds(1000));
+		ASSERT_TRUE(view.has_value()) << itemCount;
+		EXPECT_TRUE(view->ends_with(std::format(": {}", itemCount))) << *view;
+		myContainer.release();
+		itemCount++;
+	}
+
+	EXPECT_EQ(ITERATION_COUNT, myContainer.addCounter());
+	EXPECT_EQ(ITERATION_COUNT, myContainer.removeCounter());
+}
@@ -0,0 +1,73 @@
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <format>
+#include <string>
+
+#include "../include/siddiqsoft/FairQueue.hpp"
+
+
+TEST(FairQueueTests, NoisyTenantDoesNotStarve)
+{
+	siddiqsoft::FairQueue<std::string, std::string> myContainer;
+
+	// The noisy tenant fills the queue before anyone else arrives
+	for (auto i = 0; i < 1000; i++)
+		myContainer.push("noisy", std::format("noisy:{}", i));
+	for (auto i = 0; i < 5; i++)
+		myContainer.emplace("quiet", std::format("quiet:{}", i));
+	EXPECT_EQ(1005, myContainer.size());
+	EXPECT_EQ(2, myContainer.activeTenants());
+
+	// Equal weights alternate between tenants
+	for (auto i = 0; i < 5; i++)
+	{
+		EXPECT_EQ(std::format("noisy:{}", i), *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+		EXPECT_EQ(std::format("quiet:{}", i), *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+	}
+	// The quiet tenant is idle and leaves the ready list
+	EXPECT_EQ(1, myContainer.activeTenants());
+	EXPECT_EQ(0, myContainer.size("quiet"));
+	EXPECT_EQ("noisy:5", *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+}
+
+TEST(FairQueueTests, Weights)
+{
+	siddiqsoft::FairQueue<int, int> myContainer;
+
+	myContainer.setWeight(1, 3);
+	for (auto i = 0; i < 9; i++)
+	{
+		myContainer.push(1, 100 + i);
+		myContainer.push(2, 200 + i);
+	}
+
+	// Tenant 1 receives three items per round to tenant 2's one
+	std::string order;
+	for (auto i = 0; i < 8; i++)
+		order += std::to_string(*myContainer.tryWaitItem(std::chrono::milliseconds(0)) / 100);
+	EXPECT_EQ("11121112", order);
+	EXPECT_EQ(8, myContainer.removeCounter());
+	EXPECT_EQ(18, myContainer.addCounter());
+}
+
+TEST(FairQueueTests, IdleTenantsArePruned)
+{
+	siddiqsoft::FairQueue<int, int> myContainer;
+
+	myContainer.setWeight(-1, 3);
+	for (auto round = 0; round < 10; round++)
+	{
+		// Short-lived tenant ids come and go
+		for (auto tenant = 0; tenant < 100; tenant++)
+			myContainer.emplace(round * 100 + tenant, tenant);
+		EXPECT_EQ(101, myContainer.tenantCount());
+		while (myContainer.tryWaitItem(std::chrono::milliseconds(0)).has_value())
+			;
+	}
+
+	// Only the configured tenant is kept while idle
+	EXPECT_EQ(1, myContainer.tenantCount());
+	EXPECT_EQ(0, myContainer.activeTenants());
+	EXPECT_EQ(1000, myContainer.removeCounter());
+}
@@ -0,0 +1,211 @@
+#include "gtest/gtest.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "nlohmann/json.hpp"
+#include "../include/siddiqsoft/HamtMap.hpp"
+#include "../include/siddiqsoft/RWLContainer.hpp"
+
+
+/// @brief Forces every key into the same few hash buckets to exercise the collision nodes
+struct PoorHash
+{
+	size_t operator()(int key) const { return static_cast<size_t>(key % 3); }
+};
+
+
+TEST(HamtMapTests, MatchesUnorderedMap)
+{
+	siddiqsoft::HamtMap<int, int>  map {};
+	std::unordered_map<int, int>   reference {};
+	std::mt19937                   rng {42};
+	std::uniform_int_distribution  keys {0, 5000};
+
+	for (auto i = 0; i < 50000; i++)
+	{
+		auto key = keys(rng);
+		if (rng() % 3 == 0)
+		{
+			EXPECT_EQ(reference.erase(key), map.erase(key)) << key;
+		}
+		else
+		{
+			auto [iter, inserted] = map.insert_or_assign(key, i);
+			EXPECT_EQ(reference.insert_or_assign(key, i).second, inserted) << key;
+			EXPECT_EQ(key, iter->first);
+			EXPECT_EQ(i, iter->second);
+		}
+	}
+
+	EXPECT_EQ(reference.size(), map.size());
+	size_t visited {0};
+	for (const auto& [key, value] : map)
+	{
+		EXPECT_EQ(reference.at(key), value);
+		visited++;
+	}
+	EXPECT_EQ(reference.size(), visited);
+
+	for (const auto& [key, value] : reference)
+		EXPECT_EQ(value, map.find(key)->second);
+	EXPECT_EQ(map.end(), map.find(-1));
+}
+
+TEST(HamtMapTests, Collisions)
+{
+	siddiqsoft::HamtMap<int, int, PoorHash> map {};
+
+	for (auto i = 0; i < 30; i++)
+		map.insert_or_assign(i, i);
+	EXPECT_EQ(30u, map.size());
+	for (auto i = 0; i < 30; i += 2)
+		EXPECT_EQ(1u, map.erase(i));
+	EXPECT_EQ(0u, map.erase(0));
+
+	size_t visited {0};
+	for (auto iter = map.begin(); iter != map.end(); ++iter, visited++)
+		EXPECT_EQ(1, iter->first % 2);
+	EXPECT_EQ(15u, visited);
+
+	// Iteration resumes correctly from an iterator returned by find
+	visited = 0;
+	for (auto iter = map.find(1); iter != map.end(); ++iter)
+		visited++;
+	EXPECT_GE(visited, 1u);
+	EXPECT_LE(visited, 15u);
+}
+
+TEST(HamtMapTests, PersistentCopies)
+{
+	siddiqsoft::HamtMap<std::string, int> original {};
+	for (auto i = 0; i < 1000; i++)
+		original.insert_or_assign(std::format("key_{}", i), i);
+
+	// Copies share the nodes; updates on either side are invisible to the other
+	auto copy = original;
+	copy.insert_or_assign(std::string("key_1"), -1);
+	copy.erase("key_2");
+	copy.insert_or_assign(std::string("extra"), 7);
+
+	EXPECT_EQ(1, original.find("key_1")->second);
+	EXPECT_TRUE(original.contains("key_2"));
+	EXPECT_FALSE(original.contains("extra"));
+	EXPECT_EQ(1000u, original.size());
+
+	EXPECT_EQ(-1, copy.find("key_1")->second);
+	EXPECT_FALSE(copy.contains("key_2"));
+	EXPECT_EQ(1000u, copy.size());
+
+	for (auto i = 0; i < 1000; i++)
+		copy.erase(std::format("key_{}", i));
+	EXPECT_EQ(1u, copy.size());
+	EXPECT_EQ(7, copy.begin()->second);
+}
+
+/// @brief Adds, finds and then removes under a held snapshot; returns the time spent in each phase
+template <class Container>
+static std::array<std::chrono::microseconds, 3> exerciseSnapshots(Container& myContainer, size_t itemCount, size_t snapshotCount)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < itemCount; i++)
+		myContainer.add(std::format("key_{}", i), std::string("value"));
+	auto writes = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < itemCount; i++)
+		EXPECT_TRUE(myContainer.find(std::format("key_{}", i)));
+	auto reads = std::chrono::steady_clock::now();
+
+	// Readers hold a snapshot while every write publishes a new version
+	for (size_t i = 0; i < snapshotCount; i++)
+	{
+		auto view = myContainer.snapshot();
+		EXPECT_TRUE(myContainer.remove(std::format("key_{}", i)));
+		EXPECT_EQ(itemCount - i, view.size());
+		EXPECT_TRUE(view.find(std::format("key_{}", i)));
+	}
+	auto snapshots = std::chrono::steady_clock::now();
+
+	EXPECT_EQ(itemCount - snapshotCount, myContainer.size());
+	return {std::chrono::duration_cast<std::chrono::microseconds>(writes - start),
+	        std::chrono::duration_cast<std::chrono::microseconds>(reads - writes),
+	        std::chrono::duration_cast<std::chrono::microseconds>(snapshots - reads)};
+}
+
+TEST(HamtMapTests, SnapshotWrites)
+{
+	using Item = std::string;
+
+	siddiqsoft::RWLContainer<std::string, Item>                                                          mapBackend;
+	siddiqsoft::RWLContainer<std::string, Item, siddiqsoft::HamtMap<std::string, std::shared_ptr<Item>>> hamtBackend;
+
+	exerciseSnapshots(mapBackend, 2000, 50);
+	exerciseSnapshots(hamtBackend, 2000, 50);
+}
+
+/// Not part of the gate; run with --gtest_also_run_disabled_tests to compare the backends
+TEST(HamtMapTests, DISABLED_Benchmark)
+{
+	using Item = std::string;
+
+	siddiqsoft::RWLContainer<std::string, Item>                                                          mapBackend;
+	siddiqsoft::RWLContainer<std::string, Item, siddiqsoft::HamtMap<std::string, std::shared_ptr<Item>>> hamtBackend;
+
+	for (auto&& [name, cost] : {std::pair {"unordered_map", exerciseSnapshots(mapBackend, 20000, 200)},
+	                            std::pair {"HamtMap", exerciseSnapshots(hamtBackend, 20000, 200)}})
+	{
+		std::cerr << std::format("{:>14} - writes:{}us reads:{}us snapshot+write:{}us\n",
+		                         name,
+		                         cost[0].count(),
+		                         cost[1].count(),
+		                         cost[2].count());
+	}
+}
+
+TEST(HamtMapTests, RWLContainerBackend)
+{
+	siddiqsoft::RWLContainer<std::string, int, siddiqsoft::HamtMap<std::string, std::shared_ptr<int>>> myContainer;
+
+	myContainer.enableChangeFeed();
+	for (auto i = 0; i < 100; i++)
+		myContainer.add(std::format("key_{}", i), int {i});
+	EXPECT_TRUE(myContainer.remove("key_5"));
+
+	auto found = myContainer.scan([](const auto&, const auto& value) { return *value == 42; });
+	ASSERT_TRUE(found);
+	EXPECT_EQ(42, *found);
+
+	size_t   scanned {0};
+	uint64_t cursor = myContainer.scanWithCursor([&](const auto&, const auto&) { scanned++; });
+	EXPECT_EQ(99u, scanned);
+	EXPECT_EQ(101u, cursor);
+}
+
+
+TEST(HamtMapTests, BulkLoad)
+{
+	siddiqsoft::RWLContainer<std::string, int, siddiqsoft::HamtMap<std::string, std::shared_ptr<int>>> myContainer;
+
+	std::vector<std::pair<std::string, int>> items {};
+	for (auto i = 0; i < 5000; i++)
+		items.emplace_back(std::format("key_{}", i), i);
+	EXPECT_EQ(5000u, myContainer.bulkLoad(items));
+	EXPECT_EQ(5000u, myContainer.size());
+
+	// Merges into the populated trie per the duplicate policy
+	std::vector<std::pair<std::string, int>> more {{"key_1", -1}, {"extra", -2}, {"extra", -3}};
+	EXPECT_EQ(1u, myContainer.bulkLoad(more, 2, siddiqsoft::DuplicatePolicy::KeepFirst));
+	EXPECT_EQ(1, *myContainer.find("key_1"));
+	EXPECT_EQ(-2, *myContainer.find("extra"));
+	EXPECT_EQ(2u, myContainer.bulkLoad(more, 2, siddiqsoft::DuplicatePolicy::KeepLast));
+	EXPECT_EQ(-1, *myContainer.find("key_1"));
+	EXPECT_EQ(-3, *myContainer.find("extra"));
+	EXPECT_THROW(myContainer.bulkLoad(more, 2, siddiqsoft::DuplicatePolicy::Fail), std::invalid_argument);
+	EXPECT_EQ(5001u, myContainer.size());
+}
@@ -3,6 +3,7 @@
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <filesystem>
 #include <format>
 #include <functional>
 #include <queue>
@@ -15,6 +16,7 @@
 
 #include "../include/siddiqsoft/RWLContainer.hpp"
 #include "../include/siddiqsoft/WaitableQueue.hpp"
+#include "../include/siddiqsoft/SpillQueue.hpp"
 
 static std::atomic_uint64_t CountObjectsDestroyed {0};
 
@@ -294,3 +296,438 @@ TEST(WaitableQueueTests, LoadTest_3)
 	                         CountObjectsDestroyed.load());
 	EXPECT_EQ(ITERATION_COUNT, myContainer.addCounter()) << myContainer.size();
 }
+
+TEST(WaitableQueueTests, SpillToDisk)
+{
+	static const auto ITERATION_COUNT = 5000;
+	auto              spillDirectory  = std::filesystem::temp_directory_path() / "rwlcontainer-spilltest";
+	std::filesystem::create_directories(spillDirectory);
+
+	{
+		siddiqsoft::WaitableQueue<std::string, siddiqsoft::SpillQueue<std::string>> myContainer(siddiqsoft::SpillOptions {
+				.maxItemsInMemory = 16, .writeBatchBytes = 512, .segmentBytes = 4096, .directory = spillDirectory});
+
+		for (auto i = 0; i < ITERATION_COUNT; i++)
+		{
+			myContainer.push(std::format("Item---------------------------: {}", i));
+		}
+		EXPECT_EQ(ITERATION_COUNT, myContainer.size());
+		EXPECT_FALSE(std::filesystem::is_empty(spillDirectory));
+
+		// Consume half, then push more while the backlog is still on disk; FIFO must hold throughout.
+		auto expected = 0;
+		for (auto i = 0; i < ITERATION_COUNT / 2; i++)
+		{
+			auto item = myContainer.tryWaitItem();
+			ASSERT_TRUE(item.has_value());
+			EXPECT_EQ(std::format("Item---------------------------: {}", expected++), *item);
+		}
+		for (auto i = ITERATION_COUNT; i < ITERATION_COUNT + 100; i++)
+		{
+			myContainer.push(std::format("Item---------------------------: {}", i));
+		}
+		while (auto item = myContainer.tryWaitItem(std::chrono::milliseconds(0)))
+		{
+			EXPECT_EQ(std::format("Item---------------------------: {}", expected++), *item);
+		}
+		EXPECT_EQ(ITERATION_COUNT + 100, expected);
+		EXPECT_EQ(0, myContainer.size());
+		// Drained backlog discards the segment files
+		EXPECT_TRUE(std::filesystem::is_empty(spillDirectory));
+	}
+
+	std::filesystem::remove_all(spillDirectory);
+}
+
+/// @brief StringCodec which also reports the payload size used for SpillOptions::maxBytesInMemory
+struct SizedStringCodec : siddiqsoft::StringCodec
+{
+	size_t size(const std::string& value) const { return value.size(); }
+};
+
+TEST(WaitableQueueTests, SpillByteBudget)
+{
+	static const auto ITERATION_COUNT = 500;
+	auto              spillDirectory  = std::filesystem::temp_directory_path() / "rwlcontainer-spillbytes";
+	std::filesystem::create_directories(spillDirectory);
+
+	{
+		// The byte budget (about six items) is the limit, not the item count
+		siddiqsoft::WaitableQueue<std::string, siddiqsoft::SpillQueue<std::string, SizedStringCodec>> myContainer(
+				siddiqsoft::SpillOptions {.maxItemsInMemory = 1000, .maxBytesInMemory = 256, .writeBatchBytes = 512, .directory = spillDirectory});
+
+		for (auto i = 0; i < ITERATION_COUNT; i++)
+			myContainer.push(std::format("Item---------------------------: {}", i));
+		EXPECT_FALSE(std::filesystem::is_empty(spillDirectory));
+
+		// Consumed items release their bytes so every refill brings the next items back into memory
+		auto expected = 0;
+		while (auto item = myContainer.tryWaitItem(std::chrono::milliseconds(0)))
+			EXPECT_EQ(std::format("Item---------------------------: {}", expected++), *item);
+		EXPECT_EQ(ITERATION_COUNT, expected);
+		EXPECT_TRUE(std::filesystem::is_empty(spillDirectory));
+	}
+
+	std::filesystem::remove_all(spillDirectory);
+}
+
+TEST(WaitableQueueTests, SpillUnreadableSegment)
+{
+	auto spillDirectory = std::filesystem::temp_directory_path() / "rwlcontainer-spilllost";
+	std::filesystem::create_directories(spillDirectory);
+
+	{
+		siddiqsoft::SpillQueue<std::string> myQueue(siddiqsoft::SpillOptions {.maxItemsInMemory = 4, .writeBatchBytes = 1, .directory = spillDirectory});
+		for (auto i = 0; i < 20; i++)
+			myQueue.push(std::format("item-{}", i));
+		EXPECT_EQ(16, myQueue.spilledCount());
+
+		// The backlog becomes unreadable; popping must not throw into the consumer
+		for (auto& entry : std::filesystem::directory_iterator(spillDirectory))
+			std::filesystem::resize_file(entry.path(), 0);
+		for (auto i = 0; i < 4; i++)
+		{
+			EXPECT_EQ(std::format("item-{}", i), myQueue.front());
+			EXPECT_NO_THROW(myQueue.pop());
+		}
+		EXPECT_TRUE(myQueue.empty());
+		EXPECT_EQ(16, myQueue.lostCounter());
+		EXPECT_FALSE(myQueue.spillError().empty());
+
+		// The queue continues in memory
+		myQueue.push("after");
+		EXPECT_EQ("after", myQueue.front());
+	}
+
+	std::filesystem::remove_all(spillDirectory);
+}
+
+TEST(WaitableQueueTests, EmplaceInPlace)
+{
+	static const auto                       ITERATION_COUNT = 10;
+	siddiqsoft::WaitableQueue<MyTestObject> myContainer;
+
+	CountObjectsDestroyed = 0;
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+	{
+		// Arguments are forwarded to the MyTestObject constructor; no temporary is created
+		myContainer.emplace(std::format("MyObject(4):{}", i), "in-place");
+	}
+	EXPECT_EQ(0, CountObjectsDestroyed.load());
+	EXPECT_EQ(ITERATION_COUNT, myContainer.addCounter());
+
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+	{
+		auto item = myContainer.tryWaitItem(std::chrono::milliseconds(0));
+		ASSERT_TRUE(item.has_value());
+		EXPECT_EQ(std::format("MyObject(4):{}", i), item->name);
+		EXPECT_EQ("in-place", item->description.value_or(""));
+	}
+
+	// One moved-from object left in the container and one returned to the client per item
+	EXPECT_EQ(2 * ITERATION_COUNT, CountObjectsDestroyed.load());
+	EXPECT_EQ(ITERATION_COUNT, myContainer.removeCounter());
+}
+
+TEST(WaitableQueueTests, WaitBatch)
+{
+	static const auto              ITERATION_COUNT = 1000;
+	siddiqsoft::WaitableQueue<int> myContainer;
+
+	// Nothing queued; times out empty
+	EXPECT_TRUE(myContainer.waitBatch(256, 256, std::chrono::milliseconds(10), std::chrono::milliseconds(10)).empty());
+
+	// Fewer than minItems; returned once the linger period expires
+	for (auto i = 0; i < 3; i++)
+		myContainer.push(std::move(i));
+	auto startTime = std::chrono::steady_clock::now();
+	auto batch     = myContainer.waitBatch(256, 256, std::chrono::milliseconds(20));
+	EXPECT_EQ(3, batch.size());
+	EXPECT_GE(std::chrono::steady_clock::now() - startTime, std::chrono::milliseconds(15));
+
+	// Producer in the background; batches are bounded by maxItems and preserve order
+	std::jthread producer([&]() {
+		for (auto i = 0; i < ITERATION_COUNT; i++)
+		{
+			myContainer.emplace(i);
+			if (i % 100 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+
+	auto expected = 0;
+	while (expected < ITERATION_COUNT)
+	{
+		batch = myContainer.waitBatch(256, 256, std::chrono::milliseconds(50), std::chrono::milliseconds(1000));
+		ASSERT_FALSE(batch.empty());
+		EXPECT_LE(batch.size(), 256);
+		for (auto item : batch)
+			EXPECT_EQ(expected++, item);
+	}
+	EXPECT_EQ(ITERATION_COUNT + 3, myContainer.removeCounter());
+	EXPECT_EQ(0, myContainer.size());
+}
+
+TEST(WaitableQueueTests, WaitBatchLinger)
+{
+	siddiqsoft::WaitableQueue<int> myContainer;
+
+	// After a partial batch the linger period of the remaining items has already elapsed
+	for (auto i = 0; i < 4; i++)
+		myContainer.push(std::move(i));
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	auto startTime = std::chrono::steady_clock::now();
+	EXPECT_EQ(2, myContainer.waitBatch(100, 2, std::chrono::milliseconds(50)).size());
+	EXPECT_EQ(2, myContainer.waitBatch(100, 2, std::chrono::milliseconds(50)).size());
+	EXPECT_LT(std::chrono::steady_clock::now() - startTime, std::chrono::milliseconds(40));
+
+	// An item taken by tryWaitItem no longer determines the linger period
+	myContainer.push(1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	myContainer.push(2);
+	EXPECT_EQ(1, *myContainer.tryWaitItem());
+	startTime = std::chrono::steady_clock::now();
+	EXPECT_EQ(1, myContainer.waitBatch(100, 100, std::chrono::milliseconds(50)).size());
+	EXPECT_GE(std::chrono::steady_clock::now() - startTime, std::chrono::milliseconds(30));
+}
+
+TEST(WaitableQueueTests, WaitBatchPerWaiterThreshold)
+{
+	siddiqsoft::WaitableQueue<int> myContainer;
+	std::vector<int>               large {};
+	std::vector<int>               small {};
+
+	// Each waiter keeps its own minItems; a long linger means only a complete batch returns early
+	std::jthread largeWaiter([&]() {
+		large = myContainer.waitBatch(10, 100, std::chrono::milliseconds(5000), std::chrono::milliseconds(5000));
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	std::jthread smallWaiter([&]() {
+		small = myContainer.waitBatch(3, 100, std::chrono::milliseconds(5000), std::chrono::milliseconds(5000));
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	auto startTime = std::chrono::steady_clock::now();
+	for (auto i = 0; i < 3; i++)
+		myContainer.push(std::move(i));
+	smallWaiter.join();
+	EXPECT_EQ(3, small.size());
+
+	for (auto i = 0; i < 10; i++)
+		myContainer.push(std::move(i));
+	largeWaiter.join();
+	EXPECT_EQ(10, large.size());
+	EXPECT_LT(std::chrono::steady_clock::now() - startTime, std::chrono::milliseconds(2000));
+}
+
+TEST(WaitableQueueTests, CancelTicket)
+{
+	siddiqsoft::WaitableQueue<std::string> myContainer;
+
+	auto ticket0 = myContainer.push("zero");
+	auto ticket1 = myContainer.emplace("one");
+	auto ticket2 = myContainer.push("two");
+	auto ticket3 = myContainer.push("three");
+	EXPECT_EQ(ticket0 + 1, ticket1);
+
+	EXPECT_TRUE(myContainer.cancel(ticket1));
+	EXPECT_FALSE(myContainer.cancel(ticket1)); // already cancelled
+	EXPECT_TRUE(myContainer.cancel(ticket3));
+	EXPECT_FALSE(myContainer.cancel(ticket3 + 1)); // never issued
+	EXPECT_EQ(2, myContainer.size());
+	EXPECT_EQ(2, myContainer.cancelCounter());
+
+	// Tombstones are skipped by consumers
+	EXPECT_EQ("zero", *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+	EXPECT_FALSE(myContainer.cancel(ticket0)); // already consumed
+	EXPECT_EQ("two", *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+	EXPECT_FALSE(myContainer.cancel(ticket2));
+	EXPECT_FALSE(myContainer.tryWaitItem(std::chrono::milliseconds(10)).has_value());
+	EXPECT_EQ(0, myContainer.size());
+	EXPECT_EQ(2, myContainer.removeCounter());
+
+	// Tombstones are skipped by batches as well
+	auto ticket4 = myContainer.push("four");
+	myContainer.push("five");
+	EXPECT_TRUE(myContainer.cancel(ticket4));
+	auto batch = myContainer.waitBatch(2, 10, std::chrono::milliseconds(10));
+	ASSERT_EQ(1, batch.size());
+	EXPECT_EQ("five", batch[0]);
+
+	// A trailing tombstone does not keep waitUntilEmpty spinning
+	myContainer.push("six");
+	auto ticket7 = myContainer.push("seven");
+	EXPECT_TRUE(myContainer.cancel(ticket7));
+	EXPECT_EQ("six", *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+	auto startTime = std::chrono::steady_clock::now();
+	EXPECT_EQ(0, myContainer.waitUntilEmpty(std::chrono::milliseconds(1000)));
+	EXPECT_LT(std::chrono::steady_clock::now() - startTime, std::chrono::milliseconds(500));
+}
+
+TEST(WaitableQueueTests, DrainAll)
+{
+	static const auto              ITERATION_COUNT = 1000000;
+	siddiqsoft::WaitableQueue<int> myContainer;
+
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+		myContainer.emplace(i);
+	EXPECT_TRUE(myContainer.cancel(1));
+
+	auto drained = myContainer.drainAll();
+	EXPECT_EQ(ITERATION_COUNT - 1, drained.size());
+	EXPECT_EQ(0, drained.front());
+	drained.pop();
+	EXPECT_EQ(2, drained.front());
+	EXPECT_EQ(0, myContainer.size());
+	EXPECT_EQ(ITERATION_COUNT - 1, myContainer.removeCounter());
+
+	// The signals were consumed with the items; consumers do not wake for drained items
+	EXPECT_FALSE(myContainer.tryWaitItem(std::chrono::milliseconds(0)).has_value());
+
+	// The queue continues to work after a drain
+	auto ticket = myContainer.push(42);
+	EXPECT_EQ(ITERATION_COUNT, ticket);
+	EXPECT_EQ(42, *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+}
+
+TEST(WaitableQueueTests, RateLimit)
+{
+	static const auto              ITERATION_COUNT = 60;
+	siddiqsoft::WaitableQueue<int> myContainer;
+
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+		myContainer.emplace(i);
+
+	// 500 items/s with a burst of 10: the first 10 are immediate, the remaining 50 take ~100ms
+	myContainer.setRateLimit(500, 10);
+	auto startTime = std::chrono::steady_clock::now();
+	for (auto i = 0; i < 10; i++)
+		EXPECT_TRUE(myContainer.tryWaitItem(std::chrono::milliseconds(0)).has_value()) << i;
+	// Items are queued but no token is available right now
+	EXPECT_FALSE(myContainer.tryWaitItem(std::chrono::milliseconds(0)).has_value());
+	EXPECT_EQ(ITERATION_COUNT - 10, myContainer.size());
+
+	while (myContainer.size() > 0)
+		EXPECT_TRUE(myContainer.tryWaitItem(std::chrono::milliseconds(50)).has_value());
+	auto elapsed = std::chrono::steady_clock::now() - startTime;
+	EXPECT_GE(elapsed, std::chrono::milliseconds(90));
+	EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+
+	// Disabling the limit restores immediate delivery
+	myContainer.setRateLimit(0);
+	for (auto i = 0; i < 100; i++)
+		myContainer.emplace(i);
+	for (auto i = 0; i < 100; i++)
+		EXPECT_TRUE(myContainer.tryWaitItem(std::chrono::milliseconds(0)).has_value());
+}
+
+TEST(WaitableQueueTests, RateLimitRefund)
+{
+	siddiqsoft::WaitableQueue<int> myContainer;
+
+	// One token every 500ms; the first is immediate
+	myContainer.setRateLimit(2, 1);
+	myContainer.push(1);
+	EXPECT_TRUE(myContainer.tryWaitItem(std::chrono::milliseconds(0)).has_value());
+
+	// The consumer reserves the next token and sleeps for it; the item is cancelled meanwhile
+	auto ticket = myContainer.push(2);
+	std::jthread consumer([&]() { EXPECT_FALSE(myContainer.tryWaitItem(std::chrono::milliseconds(700)).has_value()); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT_TRUE(myContainer.cancel(ticket));
+	consumer.join();
+
+	// The unused token was refunded so the next item is available at once
+	myContainer.push(3);
+	EXPECT_EQ(3, *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+}
+
+TEST(WaitableQueueTests, RateLimitBatch)
+{
+	siddiqsoft::WaitableQueue<int> myContainer;
+
+	for (auto i = 0; i < 20; i++)
+		myContainer.push(std::move(i));
+	// 100 items/s: the batch of 20 needs ~190ms worth of tokens
+	myContainer.setRateLimit(100, 1);
+
+	std::vector<int> batch {};
+	std::jthread     consumer([&]() { batch = myContainer.waitBatch(20, 20, std::chrono::milliseconds(0), std::chrono::milliseconds(1000)); });
+
+	// The items stay queued while the batch waits for its tokens
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(20, myContainer.size());
+	consumer.join();
+	EXPECT_EQ(20, batch.size());
+	EXPECT_EQ(0, myContainer.size());
+}
+
+TEST(WaitableQueueTests, WakeOrder)
+{
+	for (auto order : {siddiqsoft::WakeOrder::Lifo, siddiqsoft::WakeOrder::Fifo})
+	{
+		siddiqsoft::WaitableQueue<int> myContainer;
+		std::atomic_int                firstConsumer {-1};
+
+		myContainer.setWakeOrder(order);
+		{
+			std::vector<std::jthread> consumers;
+			for (auto i = 0; i < 3; i++)
+			{
+				consumers.emplace_back([&myContainer, &firstConsumer, i]() {
+					if (auto item = myContainer.tryWaitItem(std::chrono::milliseconds(5000)); item && (*item == 0))
+						firstConsumer = i;
+				});
+				// Stagger the consumers so they park in a known order
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+
+			myContainer.push(0);
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			myContainer.push(1);
+			myContainer.push(2);
+		}
+
+		EXPECT_EQ(order == siddiqsoft::WakeOrder::Lifo ? 2 : 0, firstConsumer.load());
+		EXPECT_EQ(3, myContainer.removeCounter());
+	}
+}
+
+TEST(WaitableQueueTests, ShrinkAfterBurst)
+{
+	static const auto              ITERATION_COUNT = 100000;
+	siddiqsoft::WaitableQueue<int> myContainer;
+
+	myContainer.setShrinkPolicy(16, std::chrono::milliseconds(20));
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+		myContainer.emplace(i);
+	auto cancelled = myContainer.emplace(-1);
+	myContainer.emplace(-2);
+	EXPECT_TRUE(myContainer.cancel(cancelled));
+
+	// Drain all but the tail; nothing is released while the queue is busy
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+		EXPECT_EQ(i, *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+	EXPECT_EQ(0, myContainer.shrinkCounter());
+
+	// The depth stays low for the shrink period; the items left behind survive the shrink in order
+	myContainer.emplace(-3);
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	EXPECT_EQ(-2, *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+	EXPECT_EQ(1, myContainer.shrinkCounter());
+	EXPECT_EQ(-3, *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+	EXPECT_EQ(ITERATION_COUNT + 2, myContainer.peakSize());
+
+	// No further shrink without another burst
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	EXPECT_FALSE(myContainer.tryWaitItem(std::chrono::milliseconds(0)).has_value());
+	EXPECT_EQ(1, myContainer.shrinkCounter());
+
+	// Producers trigger the check as well; no consumer call is needed after the idle period
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+		myContainer.emplace(i);
+	auto batch = myContainer.waitBatch(ITERATION_COUNT, ITERATION_COUNT, std::chrono::milliseconds(0));
+	EXPECT_EQ(ITERATION_COUNT, batch.size());
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	myContainer.emplace(-4);
+	EXPECT_EQ(2, myContainer.shrinkCounter());
+}
@@ -0,0 +1,96 @@
+
+#include "gtest/gtest.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/siddiqsoft/WaitableQueue.hpp"
+#include "../include/siddiqsoft/ReorderBuffer.hpp"
+
+
+TEST(ReorderBufferTests, OutOfOrderCompletion)
+{
+	siddiqsoft::ReorderBuffer<std::string> myBuffer(4);
+
+	myBuffer.complete(2, "two");
+	myBuffer.complete(1, "one");
+	// Sequence 0 is missing; nothing can be released
+	EXPECT_FALSE(myBuffer.tryWaitItem(std::chrono::milliseconds(1)).has_value());
+
+	myBuffer.complete(0, "zero");
+	EXPECT_EQ("zero", *myBuffer.tryWaitItem());
+	EXPECT_EQ("one", *myBuffer.tryWaitItem());
+	EXPECT_EQ("two", *myBuffer.tryWaitItem());
+	EXPECT_EQ(3, myBuffer.nextSequence());
+}
+
+TEST(ReorderBufferTests, FanOutFanIn)
+{
+	static const auto                      ITERATION_COUNT = 20000;
+	static const int                       THREAD_COUNT    = 8;
+	siddiqsoft::WaitableQueue<int>         myContainer;
+	siddiqsoft::ReorderBuffer<std::string> myBuffer(64);
+
+	// The worker function for each thread..
+	auto workerFunction = [&](std::stop_token st) {
+		while (!st.stop_requested())
+		{
+			if (auto item = myContainer.tryWaitSequencedItem(std::chrono::milliseconds(10)); item.has_value())
+			{
+				// Uneven work so that results complete out of order
+				if (item->value % 7 == 0) std::this_thread::sleep_for(std::chrono::microseconds(50));
+				myBuffer.complete(item->sequence, std::format("Result:{}", item->value));
+			}
+		}
+	};
+
+	std::array<std::jthread, THREAD_COUNT> threadPool {};
+	for (auto& t : threadPool)
+		t = std::jthread(workerFunction);
+
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+		myContainer.emplace(i);
+
+	for (auto i = 0; i < ITERATION_COUNT; i++)
+	{
+		auto result = myBuffer.tryWaitItem(std::chrono::milliseconds(5000));
+		ASSERT_TRUE(result.has_value()) << i;
+		EXPECT_EQ(std::format("Result:{}", i), *result);
+	}
+
+	for (auto& t : threadPool)
+		t.request_stop();
+
+	EXPECT_EQ(ITERATION_COUNT, myBuffer.completeCounter());
+}
+
+
+TEST(ReorderBufferTests, SequenceSkipsOtherRemovals)
+{
+	siddiqsoft::WaitableQueue<int>                      myContainer;
+	siddiqsoft::ReorderBuffer<int>                      myBuffer(8);
+	std::vector<siddiqsoft::WaitableQueue<int>::Ticket> tickets {};
+
+	for (auto i = 0; i < 10; i++)
+		tickets.push_back(myContainer.push(std::move(i)));
+
+	// Plain takes, batches and cancellations do not leave gaps which would stall the ReorderBuffer
+	EXPECT_EQ(0, *myContainer.tryWaitItem());
+	EXPECT_EQ(0, myContainer.tryWaitSequencedItem()->sequence);
+	EXPECT_TRUE(myContainer.cancel(tickets[3]));
+	EXPECT_EQ(2, myContainer.waitBatch(2, 2, std::chrono::milliseconds(1)).size());
+	for (uint64_t expected = 1; auto item = myContainer.tryWaitSequencedItem(std::chrono::milliseconds(1)); expected++)
+	{
+		EXPECT_EQ(expected, item->sequence);
+		myBuffer.complete(item->sequence, std::move(item->value));
+	}
+
+	myBuffer.complete(0, 1);
+	for (auto expected : {1, 5, 6, 7, 8, 9})
+		EXPECT_EQ(expected, *myBuffer.tryWaitItem());
+	EXPECT_FALSE(myBuffer.tryWaitItem(std::chrono::milliseconds(1)).has_value());
+}
@@ -0,0 +1,112 @@
+
+#include "gtest/gtest.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "../include/siddiqsoft/ShardedQueue.hpp"
+
+
+TEST(ShardedQueueTests, StealFromRemoteShard)
+{
+	siddiqsoft::ShardedQueue<int> myContainer(4);
+
+	// All items land on the producer thread's home shard
+	std::jthread([&]() {
+		for (auto i = 0; i < 100; i++)
+			myContainer.emplace(i);
+	}).join();
+	EXPECT_EQ(100, myContainer.size());
+
+	// Threads are assigned consecutive home shards so the next thread must steal
+	std::jthread([&]() {
+		auto item = myContainer.tryWaitItem(std::chrono::milliseconds(0));
+		ASSERT_TRUE(item.has_value());
+		EXPECT_EQ(0, *item);
+		EXPECT_EQ(1, myContainer.stealCounter());
+
+		// The stolen batch is now local; FIFO within the batch
+		EXPECT_EQ(1, *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+		EXPECT_EQ(1, myContainer.stealCounter());
+	}).join();
+	EXPECT_EQ(98, myContainer.size());
+}
+
+TEST(ShardedQueueTests, LoadTest)
+{
+	static const auto             ITERATION_COUNT = 50000;
+	static const int              THREAD_COUNT    = 8;
+	siddiqsoft::ShardedQueue<int> myContainer(THREAD_COUNT);
+	std::atomic_uint64_t          itemCount {0};
+	std::atomic_uint64_t          itemSum {0};
+
+	{
+		std::array<std::jthread, THREAD_COUNT> consumers {};
+		for (auto& t : consumers)
+			t = std::jthread([&](std::stop_token st) {
+				while (!st.stop_requested() || myContainer.size() > 0)
+				{
+					if (auto item = myContainer.tryWaitItem(std::chrono::milliseconds(10)); item.has_value())
+					{
+						itemCount++;
+						itemSum += *item;
+					}
+				}
+			});
+
+		std::array<std::jthread, THREAD_COUNT> producers {};
+		for (auto& t : producers)
+			t = std::jthread([&]() {
+				for (auto i = 0; i < ITERATION_COUNT; i++)
+					myContainer.push(std::move(i));
+			});
+		for (auto& t : producers)
+			t.join();
+	}
+
+	// Every item consumed exactly once
+	EXPECT_EQ(uint64_t {ITERATION_COUNT} * THREAD_COUNT, itemCount.load());
+	EXPECT_EQ(uint64_t {ITERATION_COUNT} * (ITERATION_COUNT - 1) / 2 * THREAD_COUNT, itemSum.load());
+	EXPECT_EQ(itemCount.load(), myContainer.removeCounter());
+	EXPECT_EQ(itemCount.load(), myContainer.addCounter());
+	EXPECT_EQ(0, myContainer.size());
+}
+
+TEST(ShardedQueueTests, PreferSameNode)
+{
+	// Shards 0-1 belong to node 0 and shards 2-3 to node 1
+	siddiqsoft::ShardedQueue<int> myContainer(4, 2);
+	EXPECT_EQ(2, myContainer.nodeCount());
+
+	std::jthread([&]() {
+		siddiqsoft::ThreadNode::bind(1);
+		for (auto i = 0; i < 5; i++)
+			myContainer.emplace(200 + i);
+	}).join();
+	std::jthread([&]() {
+		siddiqsoft::ThreadNode::bind(0);
+		for (auto i = 0; i < 5; i++)
+			myContainer.emplace(100 + i);
+	}).join();
+	// Items may also be tagged with a node by a producer on another node
+	myContainer.pushToNode(1, 205);
+
+	std::jthread([&]() {
+		siddiqsoft::ThreadNode::bind(0);
+		// All node 0 items are consumed before any remote item
+		for (auto i = 0; i < 5; i++)
+			EXPECT_EQ(100 + i, *myContainer.tryWaitItem(std::chrono::milliseconds(0)));
+		EXPECT_EQ(0, myContainer.remoteStealCounter());
+
+		for (auto i = 0; i < 6; i++)
+		{
+			auto item = myContainer.tryWaitItem(std::chrono::milliseconds(0));
+			ASSERT_TRUE(item.has_value());
+			EXPECT_GE(*item, 200);
+		}
+		EXPECT_LE(1, myContainer.remoteStealCounter());
+	}).join();
+	EXPECT_EQ(0, myContainer.size());
+}
@@ -0,0 +1,145 @@
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "../include/siddiqsoft/SharedMemoryQueue.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct MyRecord
+{
+	uint64_t id;
+	char     payload[48];
+};
+
+TEST(SharedMemoryQueueTests, CrossProcess)
+{
+	static const auto ITERATION_COUNT = 100000;
+	const std::string name            = std::format("/rwlshmq-test-{}", ::getpid());
+
+	siddiqsoft::SharedMemoryQueue<MyRecord, 256>::unlink(name);
+	siddiqsoft::SharedMemoryQueue<MyRecord, 256> myContainer(name);
+
+	auto child = ::fork();
+	ASSERT_GE(child, 0);
+	if (child == 0)
+	{
+		// Producer process attaches to the existing region
+		int rc = 0;
+		try
+		{
+			siddiqsoft::SharedMemoryQueue<MyRecord, 256> producer(name);
+			for (uint64_t i = 0; i < ITERATION_COUNT; i++)
+			{
+				MyRecord record {i, {}};
+				while (!producer.push(record))
+					;
+			}
+		}
+		catch (...)
+		{
+			rc = 1;
+		}
+		::_exit(rc);
+	}
+
+	uint64_t expected = 0;
+	while (expected < ITERATION_COUNT)
+	{
+		auto item = myContainer.tryWaitItem(std::chrono::milliseconds(5000));
+		ASSERT_TRUE(item.has_value()) << expected;
+		EXPECT_EQ(expected++, item->id);
+	}
+
+	int status = -1;
+	::waitpid(child, &status, 0);
+	EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	EXPECT_EQ(ITERATION_COUNT, myContainer.addCounter());
+	EXPECT_EQ(0, myContainer.size());
+
+	siddiqsoft::SharedMemoryQueue<MyRecord, 256>::unlink(name);
+}
+
+TEST(SharedMemoryQueueTests, ResumeAfterRestart)
+{
+	const std::string name = std::format("/rwlshmq-resume-{}", ::getpid());
+
+	siddiqsoft::SharedMemoryQueue<uint64_t, 8>::unlink(name);
+	{
+		siddiqsoft::SharedMemoryQueue<uint64_t, 8> myContainer(name);
+		for (uint64_t i = 0; i < 8; i++)
+			EXPECT_TRUE(myContainer.push(i));
+		// Full ring times out
+		EXPECT_FALSE(myContainer.push(99, std::chrono::milliseconds(10)));
+		EXPECT_EQ(0, *myContainer.tryWaitItem());
+	}
+	{
+		// A new process attaching continues from the stored indices
+		siddiqsoft::SharedMemoryQueue<uint64_t, 8> myContainer(name);
+		EXPECT_EQ(7, myContainer.size());
+		EXPECT_EQ(1, *myContainer.tryWaitItem());
+	}
+	// Mismatched layouts are rejected
+	EXPECT_THROW((siddiqsoft::SharedMemoryQueue<uint64_t, 16>(name)), std::runtime_error);
+
+	siddiqsoft::SharedMemoryQueue<uint64_t, 8>::unlink(name);
+}
+
+TEST(SharedMemoryQueueTests, AttachWakesParkedPeer)
+{
+	const std::string name = std::format("/rwlshmq-parked-{}", ::getpid());
+
+	siddiqsoft::SharedMemoryQueue<uint64_t, 8>::unlink(name);
+	siddiqsoft::SharedMemoryQueue<uint64_t, 8> consumer(name);
+
+	std::optional<uint64_t>             item {};
+	std::chrono::steady_clock::duration waited {};
+	std::thread                         waiter([&]() {
+		auto start = std::chrono::steady_clock::now();
+		item       = consumer.tryWaitItem(std::chrono::milliseconds(5000));
+		waited     = std::chrono::steady_clock::now() - start;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	// The producer attaches while the consumer is parked; its push must still wake the consumer
+	siddiqsoft::SharedMemoryQueue<uint64_t, 8> producer(name);
+	EXPECT_TRUE(producer.push(42));
+	waiter.join();
+
+	ASSERT_TRUE(item.has_value());
+	EXPECT_EQ(42, *item);
+	EXPECT_LT(waited, std::chrono::milliseconds(4000));
+
+	siddiqsoft::SharedMemoryQueue<uint64_t, 8>::unlink(name);
+}
+
+TEST(SharedMemoryQueueTests, CreatorDiedBeforeInitializing)
+{
+	const std::string name = std::format("/rwlshmq-orphan-{}", ::getpid());
+
+	for (auto size : {size_t {0}, size_t {1} << 16})
+	{
+		// Simulates a creator that died after shm_open (and ftruncate) but before publishing the region
+		siddiqsoft::SharedMemoryQueue<uint64_t, 8>::unlink(name);
+		auto fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		ASSERT_GE(fd, 0);
+		if (size > 0) ASSERT_EQ(0, ::ftruncate(fd, static_cast<off_t>(size)));
+		::close(fd);
+
+		siddiqsoft::SharedMemoryQueue<uint64_t, 8> myContainer(name);
+		EXPECT_TRUE(myContainer.push(7));
+		EXPECT_EQ(7, *myContainer.tryWaitItem());
+	}
+
+	siddiqsoft::SharedMemoryQueue<uint64_t, 8>::unlink(name);
+}
+#endif
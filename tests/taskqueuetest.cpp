@@ -0,0 +1,154 @@
+
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/siddiqsoft/TaskQueue.hpp"
+
+
+TEST(TaskQueueTests, SubmitAndGet)
+{
+	siddiqsoft::TaskQueue myQueue(2);
+
+	auto answer = myQueue.submit([]() { return 6 * 7; });
+	auto text   = myQueue.submit([]() { return std::string("hello"); });
+	auto none   = myQueue.submit([]() {});
+
+	EXPECT_EQ(42, answer.get());
+	EXPECT_FALSE(answer.valid());
+	EXPECT_EQ("hello", text.get());
+	none.wait();
+	EXPECT_TRUE(none.isReady());
+	none.get();
+}
+
+TEST(TaskQueueTests, Exception)
+{
+	siddiqsoft::TaskQueue myQueue(1);
+
+	auto failed = myQueue.submit([]() -> int { throw std::runtime_error("boom"); });
+	EXPECT_THROW(failed.get(), std::runtime_error);
+
+	// The exception skips the continuation and reaches the end of the chain
+	std::atomic_bool ran {false};
+	auto             chained = myQueue.submit([]() -> int { throw std::invalid_argument("bad"); }).then([&](int v) {
+        ran = true;
+        return v + 1;
+    });
+	EXPECT_THROW(chained.get(), std::invalid_argument);
+	EXPECT_FALSE(ran.load());
+}
+
+TEST(TaskQueueTests, ThenRunsOnWorker)
+{
+	siddiqsoft::TaskQueue myQueue(1);
+	std::atomic_bool      release {false};
+	std::thread::id       workerId {};
+	std::thread::id       continuationId {};
+
+	auto result = myQueue.submit([&]() {
+		                     workerId = std::this_thread::get_id();
+		                     while (!release.load())
+			                     std::this_thread::yield();
+		                     return 20;
+	                     })
+	                      .then([&](int v) {
+		                      continuationId = std::this_thread::get_id();
+		                      return v * 2;
+	                      })
+	                      .then([](int v) { return std::to_string(v + 2); });
+
+	// The continuation is installed before the task completes so it must run on the worker
+	release = true;
+	EXPECT_EQ("42", result.get());
+	EXPECT_EQ(workerId, continuationId);
+	EXPECT_NE(std::this_thread::get_id(), continuationId);
+
+	// Chaining onto a completed task runs inline on the caller
+	auto done = myQueue.submit([]() { return 1; });
+	done.wait();
+	auto inlined = std::move(done).then([&](int v) {
+		continuationId = std::this_thread::get_id();
+		return v + 1;
+	});
+	EXPECT_TRUE(inlined.isReady());
+	EXPECT_EQ(2, inlined.get());
+	EXPECT_EQ(std::this_thread::get_id(), continuationId);
+}
+
+TEST(TaskQueueTests, LoadTest)
+{
+	static const auto ITERATION_COUNT = 100000;
+	std::atomic_int   continuations {0};
+	uint64_t          sum {0};
+
+	{
+		siddiqsoft::TaskQueue                     myQueue(4);
+		std::vector<siddiqsoft::TaskFuture<int>> futures {};
+		futures.reserve(ITERATION_COUNT);
+
+		for (auto i = 0; i < ITERATION_COUNT; i++)
+		{
+			if (i % 2)
+				futures.push_back(myQueue.submit([i]() { return i; }));
+			else
+				futures.push_back(myQueue.submit([i]() { return i; }).then([&](int v) {
+					continuations++;
+					return v;
+				}));
+		}
+
+		for (auto& f : futures)
+			sum += f.get();
+
+		EXPECT_EQ(ITERATION_COUNT, myQueue.submitCounter());
+	}
+
+	EXPECT_EQ(uint64_t {ITERATION_COUNT} * (ITERATION_COUNT - 1) / 2, sum);
+	EXPECT_EQ(ITERATION_COUNT / 2, continuations.load());
+}
+
+TEST(TaskQueueTests, DestructorCompletesQueuedTasks)
+{
+	std::atomic_int completed {0};
+	{
+		siddiqsoft::TaskQueue myQueue(1);
+		for (auto i = 0; i < 100; i++)
+			(void)myQueue.submit([&]() { completed++; });
+	}
+	EXPECT_EQ(100, completed.load());
+}
+
+
+TEST(TaskQueueTests, StatesAreReused)
+{
+	// A result type used only here so that other tests do not touch its pool
+	struct PoolProbe
+	{
+		int value {0};
+	};
+	static const auto ROUND_TRIPS = 1000;
+	siddiqsoft::TaskQueue myQueue(2);
+
+	// Submitted on this thread, released on the workers: the shared pool still supplies every state after the first
+	for (auto i = 0; i < ROUND_TRIPS; i++)
+	{
+		auto future = myQueue.submit([i]() { return PoolProbe {i}; });
+		EXPECT_EQ(i, future.get().value);
+	}
+	EXPECT_LE(siddiqsoft::TaskState<PoolProbe>::poolMisses(), 2);
+	EXPECT_GE(siddiqsoft::TaskState<PoolProbe>::poolHits(), ROUND_TRIPS - 2);
+
+	// Continuations reuse pooled states as well
+	for (auto i = 0; i < ROUND_TRIPS; i++)
+	{
+		auto future = myQueue.submit([i]() { return PoolProbe {i}; }).then([](PoolProbe probe) { return PoolProbe {probe.value + 1}; });
+		EXPECT_EQ(i + 1, future.get().value);
+	}
+	EXPECT_LE(siddiqsoft::TaskState<PoolProbe>::poolMisses(), 4);
+}
+
@@ -35,10 +35,25 @@
  */
 
 #include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include "nlohmann/json.hpp"
 #include "../include/siddiqsoft/RWLContainer.hpp"
 
+#if defined(__linux__)
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
 
 struct MyItem
 {
@@ -387,3 +402,666 @@ TEST(RWContainer_scan, BasicScanNegative)
 		EXPECT_TRUE(false); // if we throw then the test fails.
 	}
 }
+
+
+TEST(RWContainer_feed, ChangeFeed)
+{
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	// Opt-in: nothing is recorded before the feed is enabled
+	myContainer.add("before", {5, "bar"});
+	EXPECT_THROW(myContainer.changeFeed(), std::runtime_error);
+	myContainer.enableChangeFeed(4);
+
+	// A follower bootstraps from a scan and then follows the feed
+	std::map<std::string, MyItemPtr> mirror {};
+	uint64_t                         cursor = myContainer.scanWithCursor([&](const auto& key, auto& val) { mirror[key] = val; });
+	EXPECT_EQ(0, cursor);
+
+	myContainer.ReplaceExisting = true;
+	myContainer.add("foo", {1, "bar"});
+	myContainer.add("foo", {2, "baz"});
+	EXPECT_TRUE(myContainer.remove("before"));
+	EXPECT_FALSE(myContainer.remove("not-there")); // failed mutations are not recorded
+
+	auto& feed    = myContainer.changeFeed();
+	auto  records = feed.read(cursor, 2);
+	ASSERT_EQ(2, records.size());
+	EXPECT_EQ(siddiqsoft::ChangeOp::Insert, records[0].op);
+	EXPECT_EQ(siddiqsoft::ChangeOp::Replace, records[1].op);
+	EXPECT_EQ("baz", records[1].value->name);
+	EXPECT_EQ(1, records[1].version);
+	EXPECT_EQ(2, cursor);
+
+	records = feed.read(cursor);
+	ASSERT_EQ(1, records.size());
+	EXPECT_EQ(siddiqsoft::ChangeOp::Remove, records[0].op);
+	EXPECT_EQ("before", records[0].key);
+	EXPECT_FALSE(records[0].value);
+	EXPECT_TRUE(feed.read(cursor).empty());
+
+	for (const auto& record : feed.read(cursor = 0))
+	{
+		if (record.op == siddiqsoft::ChangeOp::Remove)
+			mirror.erase(record.key);
+		else
+			mirror[record.key] = record.value;
+	}
+	EXPECT_EQ(1, mirror.size());
+	EXPECT_EQ(2, mirror["foo"]->flag);
+
+	// A follower which falls behind by more than the capacity must resync
+	for (auto i = 0; i < 5; i++)
+		myContainer.add(std::format("item_{}", i), {i, "bar"});
+	EXPECT_EQ(8, feed.head());
+	EXPECT_EQ(4, feed.tail());
+	EXPECT_THROW((void)feed.read(cursor), std::out_of_range);
+
+	nlohmann::json doc = myContainer.toJson();
+	EXPECT_EQ(8, doc.value("changes", 0));
+}
+
+TEST(RWContainer_feed, ConcurrentFollower)
+{
+	const int                                     ITEM_COUNT = 50000;
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	myContainer.enableChangeFeed(64);
+	auto& feed = myContainer.changeFeed();
+
+	// A follower copying while the writer laps the small ring either gets intact consecutive records or is overrun
+	std::atomic_bool done {false};
+	uint64_t         copied {0};
+	std::jthread     follower([&]() {
+		uint64_t cursor = feed.head();
+		while (!done.load() || (cursor < feed.head()))
+		{
+			try
+			{
+				for (const auto& record : feed.read(cursor, 16))
+				{
+					EXPECT_EQ(std::format("foo_{}", record.version), record.key);
+					EXPECT_EQ(static_cast<int>(record.version) + 1, record.value->flag);
+					copied++;
+				}
+			}
+			catch (const std::out_of_range&)
+			{
+				// Resync from the oldest record still available
+				cursor = feed.tail();
+			}
+		}
+	});
+
+	for (auto i = 0; i < ITEM_COUNT; i++)
+		myContainer.add(std::format("foo_{}", i), {i + 1, "bar"});
+	done = true;
+	follower.join();
+
+	EXPECT_GT(copied, 0);
+	EXPECT_EQ(ITEM_COUNT, feed.head());
+}
+
+
+struct MyItemCodec
+{
+	std::string encode(const MyItem& item) const
+	{
+		return std::string(reinterpret_cast<const char*>(&item.flag), sizeof(item.flag)).append(item.name);
+	}
+
+	MyItem decode(std::string_view bytes) const
+	{
+		MyItem item {};
+		std::memcpy(&item.flag, bytes.data(), sizeof(item.flag));
+		item.name = bytes.substr(sizeof(item.flag));
+		return item;
+	}
+};
+
+
+TEST(RWContainer_snapshot, SaveAndLoad)
+{
+	const int                                     ITEM_COUNT = 20000;
+	auto                                          path = std::filesystem::temp_directory_path() / "rwlcontainer-test.snap";
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	for (auto i = 0; i < ITEM_COUNT; i++)
+		myContainer.add(std::format("foo_{}", i), {i, std::format("bar_{}", i)});
+	EXPECT_EQ(ITEM_COUNT, myContainer.saveSnapshot(path, MyItemCodec {}));
+
+	siddiqsoft::RWLContainer<std::string, MyItem> restored;
+	restored.add("foo_1", {-1, "stale"});
+	EXPECT_EQ(ITEM_COUNT, restored.loadSnapshot(path, MyItemCodec {}));
+	EXPECT_EQ(ITEM_COUNT, restored.size());
+	for (auto i = 0; i < ITEM_COUNT; i += 997)
+	{
+		auto item = restored.find(std::format("foo_{}", i));
+		ASSERT_TRUE(item) << i;
+		EXPECT_EQ(i, item->flag);
+		EXPECT_EQ(std::format("bar_{}", i), item->name);
+	}
+	// The snapshot replaces existing items
+	EXPECT_EQ(1, restored.find("foo_1")->flag);
+
+	// A truncated image is rejected without touching the container
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 10);
+	siddiqsoft::RWLContainer<std::string, MyItem> damaged;
+	EXPECT_THROW(damaged.loadSnapshot(path, MyItemCodec {}), std::runtime_error);
+	EXPECT_EQ(0, damaged.size());
+	std::filesystem::remove(path);
+	EXPECT_THROW(damaged.loadSnapshot(path, MyItemCodec {}), std::runtime_error);
+}
+
+
+TEST(RWContainer_snapshot, CorruptImage)
+{
+	auto                                          path = std::filesystem::temp_directory_path() / "rwlcontainer-corrupt.snap";
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	for (auto i = 1; i <= 1000; i++)
+		myContainer.add(std::format("foo_{}", i), {i, std::format("bar_{}", i)});
+	EXPECT_EQ(1000, myContainer.saveSnapshot(path, MyItemCodec {}));
+
+	// Flip a byte inside the records; the lengths stay plausible so only the checksum catches it
+	auto size = std::filesystem::file_size(path);
+	if (std::fstream file {path, std::ios::binary | std::ios::in | std::ios::out}; file)
+	{
+		file.seekg(static_cast<std::streamoff>(size - 3));
+		char c {};
+		file.get(c);
+		file.seekp(static_cast<std::streamoff>(size - 3));
+		file.put(static_cast<char>(c ^ 0x5a));
+	}
+	siddiqsoft::RWLContainer<std::string, MyItem> damaged;
+	EXPECT_THROW(damaged.loadSnapshot(path, MyItemCodec {}), std::runtime_error);
+	EXPECT_EQ(0, damaged.size());
+	std::filesystem::remove(path);
+}
+
+
+TEST(RWContainer_snapshot, ConcurrentSaves)
+{
+	auto                                          path = std::filesystem::temp_directory_path() / "rwlcontainer-concurrent.snap";
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	for (auto i = 1; i <= 2000; i++)
+		myContainer.add(std::format("foo_{}", i), {i, std::format("bar_{}", i)});
+
+	// Each save writes its own temporary file so none of them fail or interleave
+	if (std::vector<std::jthread> savers {}; true)
+	{
+		for (auto t = 0; t < 4; t++)
+			savers.emplace_back([&]() { EXPECT_EQ(2000, myContainer.saveSnapshot(path, MyItemCodec {})); });
+	}
+
+	siddiqsoft::RWLContainer<std::string, MyItem> restored;
+	EXPECT_EQ(2000, restored.loadSnapshot(path, MyItemCodec {}));
+	EXPECT_EQ(2000, restored.size());
+	for (const auto& entry : std::filesystem::directory_iterator(path.parent_path()))
+		EXPECT_FALSE(entry.path().filename().string().starts_with("rwlcontainer-concurrent.snap.")) << entry.path();
+	std::filesystem::remove(path);
+}
+
+TEST(RWContainer_journal, ReplayAfterRestart)
+{
+	const int THREAD_COUNT = 4;
+	const int ITEM_COUNT   = 200;
+	auto      path         = std::filesystem::temp_directory_path() / "rwlcontainer-test.wal";
+	std::filesystem::remove(path);
+
+	{
+		siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+		EXPECT_EQ(0, myContainer.enableJournal(path, MyItemCodec {}));
+		myContainer.ReplaceExisting = true;
+
+		// Concurrent writers wait for durability outside the lock and share group commits
+		{
+			std::vector<std::jthread> writers {};
+			for (auto t = 0; t < THREAD_COUNT; t++)
+				writers.emplace_back([&, t]() {
+					for (auto i = 0; i < ITEM_COUNT; i++)
+						myContainer.add(std::format("foo_{}_{}", t, i), {i, "bar"});
+				});
+		}
+		myContainer.add("foo_0_0", {-1, "replaced"});
+		EXPECT_TRUE(myContainer.remove("foo_0_1"));
+
+		nlohmann::json doc = myContainer.toJson();
+		EXPECT_EQ(THREAD_COUNT * ITEM_COUNT + 2, doc.value("journalLsn", 0));
+		EXPECT_LT(doc.value("journalCommits", 0), THREAD_COUNT * ITEM_COUNT);
+	}
+
+	// Simulate a crash in the middle of a write
+	if (std::ofstream file {path, std::ios::binary | std::ios::app}; file) file.write("\x40\x00\x00\x00torn", 8);
+
+	siddiqsoft::RWLContainer<std::string, MyItem> restored;
+	EXPECT_EQ(THREAD_COUNT * ITEM_COUNT + 2, restored.enableJournal(path, MyItemCodec {}));
+	EXPECT_EQ(THREAD_COUNT * ITEM_COUNT - 1, restored.size());
+	EXPECT_EQ("replaced", restored.find("foo_0_0")->name);
+	EXPECT_FALSE(restored.find("foo_0_1"));
+	EXPECT_EQ(7, restored.find("foo_3_7")->flag);
+
+	// New records follow the last valid record
+	restored.add("after", {42, "crash"});
+	EXPECT_TRUE(restored.flushJournal());
+	uint64_t records = siddiqsoft::Journal::replay(path, [](std::string_view) {});
+	EXPECT_EQ(THREAD_COUNT * ITEM_COUNT + 3, records);
+	std::filesystem::remove(path);
+}
+
+
+TEST(RWContainer_journal, CheckpointOnSnapshot)
+{
+	auto journalPath  = std::filesystem::temp_directory_path() / "rwlcontainer-checkpoint.wal";
+	auto snapshotPath = std::filesystem::temp_directory_path() / "rwlcontainer-checkpoint.snap";
+	std::filesystem::remove(journalPath);
+
+	{
+		siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+		myContainer.enableJournal(journalPath, MyItemCodec {});
+		for (auto i = 1; i <= 100; i++)
+			myContainer.add(std::format("foo_{}", i), {i, "bar"});
+
+		// The image covers every record so far; only later records stay in the journal
+		EXPECT_EQ(100, myContainer.saveSnapshot(snapshotPath, MyItemCodec {}));
+		EXPECT_EQ(0, siddiqsoft::Journal::replay(journalPath, [](std::string_view) {}));
+		for (auto i = 101; i <= 105; i++)
+			myContainer.add(std::format("foo_{}", i), {i, "bar"});
+		EXPECT_TRUE(myContainer.remove("foo_1"));
+
+		nlohmann::json doc = myContainer.toJson();
+		EXPECT_EQ(1, doc.value("journalCheckpoints", 0));
+	}
+	EXPECT_EQ(6, siddiqsoft::Journal::replay(journalPath, [](std::string_view) {}));
+
+	siddiqsoft::RWLContainer<std::string, MyItem> restored;
+	EXPECT_EQ(100, restored.loadSnapshot(snapshotPath, MyItemCodec {}));
+	EXPECT_EQ(6, restored.enableJournal(journalPath, MyItemCodec {}));
+	EXPECT_EQ(104, restored.size());
+	EXPECT_FALSE(restored.find("foo_1"));
+	EXPECT_EQ(105, restored.find("foo_105")->flag);
+	restored.add("after", {1, "checkpoint"});
+	EXPECT_TRUE(restored.flushJournal());
+	EXPECT_EQ(7, siddiqsoft::Journal::replay(journalPath, [](std::string_view) {}));
+
+	std::filesystem::remove(journalPath);
+	std::filesystem::remove(snapshotPath);
+}
+
+
+#if defined(__linux__)
+TEST(RWContainer_journal, FailedCommitIsReverted)
+{
+	auto path = std::filesystem::temp_directory_path() / "rwlcontainer-failed.wal";
+	std::filesystem::remove(path);
+
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+	myContainer.ReplaceExisting = true;
+	myContainer.enableJournal(path, MyItemCodec {});
+	myContainer.add("foo", {1, "durable"});
+
+	// Limit the file size so that the next commit fails with EFBIG
+	rlimit previous {};
+	ASSERT_EQ(0, ::getrlimit(RLIMIT_FSIZE, &previous));
+	auto   handler = std::signal(SIGXFSZ, SIG_IGN);
+	rlimit limited {static_cast<rlim_t>(std::filesystem::file_size(path) + 16), previous.rlim_max};
+	ASSERT_EQ(0, ::setrlimit(RLIMIT_FSIZE, &limited));
+
+	EXPECT_THROW(myContainer.add("foo", {2, std::string(1024, 'x')}), std::runtime_error);
+	EXPECT_THROW(myContainer.add("bar", {3, "rejected"}), std::runtime_error);
+	EXPECT_THROW((void)myContainer.remove("foo"), std::runtime_error);
+
+	::setrlimit(RLIMIT_FSIZE, &previous);
+	std::signal(SIGXFSZ, handler);
+
+	// The failed replace was reverted and the later mutations were never applied
+	EXPECT_EQ("durable", myContainer.find("foo")->name);
+	EXPECT_FALSE(myContainer.find("bar"));
+	EXPECT_EQ(1, myContainer.size());
+	std::filesystem::remove(path);
+}
+#endif
+
+TEST(RWContainer_snapshot, PointInTimeView)
+{
+	const int                                     ITEM_COUNT = 1000;
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	for (auto i = 0; i < ITEM_COUNT; i++)
+		myContainer.add(std::format("foo_{}", i), {i, "bar"});
+
+	auto view = myContainer.snapshot();
+	EXPECT_EQ(ITEM_COUNT, view.size());
+
+	// Writers continue while the snapshot is held; the first mutation copies the container once
+	std::jthread([&]() {
+		for (auto i = 0; i < ITEM_COUNT; i++)
+		{
+			myContainer.add(std::format("new_{}", i), {i, "baz"});
+			EXPECT_TRUE(myContainer.remove(std::format("foo_{}", i)));
+		}
+	}).join();
+	EXPECT_EQ(ITEM_COUNT, myContainer.size());
+	EXPECT_EQ(1, myContainer.toJson().value("copies", 0));
+
+	// The view is unchanged and is iterated without any lock
+	size_t seen {0};
+	for (const auto& [key, value] : view)
+	{
+		EXPECT_TRUE(key.starts_with("foo_"));
+		seen++;
+	}
+	EXPECT_EQ(ITEM_COUNT, seen);
+	EXPECT_TRUE(view.find("foo_7"));
+	EXPECT_FALSE(view.find("new_7"));
+
+	// Once released, the old version is reclaimed and writers no longer copy
+	std::weak_ptr<MyItem> oldItem = view.find("foo_7");
+	view                          = {};
+	EXPECT_TRUE(oldItem.expired());
+	myContainer.add("another", {1, "bar"});
+	EXPECT_EQ(1, myContainer.toJson().value("copies", 0));
+}
+
+
+void to_json(nlohmann::json& doc, const MyItem& item)
+{
+	doc = nlohmann::json {{"flag", item.flag}, {"name", item.name}};
+}
+
+void from_json(const nlohmann::json& doc, MyItem& item)
+{
+	doc.at("flag").get_to(item.flag);
+	doc.at("name").get_to(item.name);
+}
+
+
+TEST(RWContainer_export, StreamJsonLines)
+{
+	const int                                     ITEM_COUNT = 20000;
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	for (auto i = 0; i < ITEM_COUNT; i++)
+		myContainer.add(std::format("foo_{}", i), {i, "bar\t\"quoted\""});
+
+	std::ostringstream out {};
+	EXPECT_EQ(ITEM_COUNT,
+	          myContainer.exportTo(siddiqsoft::ExportWriter::toStream(out), siddiqsoft::ExportFormat::JsonLines, siddiqsoft::JsonCodec<MyItem> {}));
+
+	std::istringstream in {out.str()};
+	std::string        line {};
+	size_t             lines {0};
+	while (std::getline(in, line))
+	{
+		auto doc = nlohmann::json::parse(line);
+		auto key = doc["key"].get<std::string>();
+		EXPECT_EQ(key, std::format("foo_{}", doc["value"]["flag"].get<int>()));
+		EXPECT_EQ("bar\t\"quoted\"", doc["value"]["name"].get<std::string>());
+		lines++;
+	}
+	EXPECT_EQ(ITEM_COUNT, lines);
+}
+
+
+TEST(RWContainer_export, StreamBinaryChunks)
+{
+	const int                                     ITEM_COUNT  = 20000;
+	const size_t                                  CHUNK_BYTES = 4096;
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+
+	for (auto i = 0; i < ITEM_COUNT; i++)
+		myContainer.add(std::format("foo_{}", i), {i, "bar"});
+
+	size_t chunks {0};
+	size_t bytes {0};
+	auto   exported = myContainer.exportTo(
+            [&](std::string_view chunk) {
+                // Bounded chunks; no lock is held so writers continue during the export
+                EXPECT_LT(chunk.size(), CHUNK_BYTES + 64);
+                myContainer.add(std::format("during_{}", chunks), {-1, "new"});
+                chunks++;
+                bytes += chunk.size();
+            },
+            siddiqsoft::ExportFormat::Binary,
+            MyItemCodec {},
+            siddiqsoft::StringCodec {},
+            CHUNK_BYTES);
+
+	// The export reflects the container when it started
+	EXPECT_EQ(ITEM_COUNT, exported);
+	EXPECT_EQ(ITEM_COUNT + chunks, myContainer.size());
+	EXPECT_GT(chunks, 10);
+	EXPECT_GT(bytes, ITEM_COUNT * (sizeof(uint32_t) * 2 + 4 + sizeof(int)));
+}
+
+
+TEST(RWContainer_bulkLoad, MatchesAddLoop)
+{
+	const int                                   ITEM_COUNT = 200000;
+	std::vector<std::pair<std::string, MyItem>> items {};
+	items.reserve(ITEM_COUNT);
+	for (auto i = 0; i < ITEM_COUNT; i++)
+		items.emplace_back(std::format("foo_{}", i), MyItem {i, "bar"});
+
+	siddiqsoft::RWLContainer<std::string, MyItem> looped;
+	for (auto& [key, value] : items)
+		looped.add(key, MyItem {value});
+
+	// Cold start: the container is built outside the lock and swapped in
+	siddiqsoft::RWLContainer<std::string, MyItem> loaded;
+	loaded.enableChangeFeed(ITEM_COUNT);
+	EXPECT_EQ(ITEM_COUNT, loaded.bulkLoad(std::move(items)));
+	EXPECT_EQ(looped.size(), loaded.size());
+	EXPECT_EQ(ITEM_COUNT, loaded.toJson()["adds"].get<uint64_t>());
+	EXPECT_EQ(ITEM_COUNT, loaded.changeFeed().head());
+	looped.scan([&](const std::string& key, const MyItemPtr& item) {
+		auto found = loaded.find(key);
+		EXPECT_TRUE(found && (found->flag == item->flag));
+		return false;
+	});
+
+	// Merge into a populated container
+	std::vector<std::pair<std::string, MyItem>> more {{"foo_1", {-1, "replaced"}}, {"extra", {-2, "new"}}};
+	EXPECT_EQ(2, loaded.bulkLoad(more, 2, siddiqsoft::DuplicatePolicy::KeepLast));
+	EXPECT_EQ(ITEM_COUNT + 1, loaded.size());
+	EXPECT_EQ(-1, loaded.find("foo_1")->flag);
+	EXPECT_EQ(ITEM_COUNT + 2, loaded.changeFeed().head());
+}
+
+
+TEST(RWContainer_bulkLoad, UniqueIndexRejectsWholeBatch)
+{
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+	myContainer.enableChangeFeed();
+	auto byEmail = myContainer.registerIndex([](const MyItem& item) { return item.name; }, true);
+
+	// The violation is the last item; nothing before it is applied or published
+	std::vector<std::pair<std::string, MyItem>> items {{"s1", {1, "alice"}}, {"s2", {2, "bob"}}, {"s3", {3, "alice"}}};
+	EXPECT_THROW(myContainer.bulkLoad(items, 1, siddiqsoft::DuplicatePolicy::KeepLast), std::invalid_argument);
+	EXPECT_EQ(0, myContainer.size());
+	EXPECT_EQ(0, myContainer.changeFeed().head());
+	EXPECT_FALSE(myContainer.findBy(byEmail, "alice"));
+
+	myContainer.add("s0", {9, "carol"});
+	items.pop_back();
+	items.emplace_back("s3", MyItem {3, "carol"});
+	EXPECT_THROW(myContainer.bulkLoad(items, 1, siddiqsoft::DuplicatePolicy::KeepLast), std::invalid_argument);
+	EXPECT_EQ(1, myContainer.size());
+	EXPECT_EQ(1, myContainer.changeFeed().head());
+
+	// Keys which hand their value to one another within the batch are accepted
+	items = {{"s0", {9, "dave"}}, {"s3", {3, "carol"}}};
+	EXPECT_EQ(2, myContainer.bulkLoad(items, 1, siddiqsoft::DuplicatePolicy::KeepLast));
+	EXPECT_EQ(3, myContainer.findBy(byEmail, "carol")->flag);
+	EXPECT_EQ(9, myContainer.findBy(byEmail, "dave")->flag);
+}
+
+
+TEST(RWContainer_bulkLoad, DuplicatePolicies)
+{
+	std::vector<std::pair<std::string, MyItem>> items {{"a", {1, "first"}}, {"b", {2, "b"}}, {"a", {3, "last"}}};
+
+	siddiqsoft::RWLContainer<std::string, MyItem> keepFirst;
+	keepFirst.add("b", {9, "existing"});
+	EXPECT_EQ(1, keepFirst.bulkLoad(items, 2, siddiqsoft::DuplicatePolicy::KeepFirst));
+	EXPECT_EQ("first", keepFirst.find("a")->name);
+	EXPECT_EQ("existing", keepFirst.find("b")->name);
+
+	siddiqsoft::RWLContainer<std::string, MyItem> keepLast;
+	keepLast.add("b", {9, "existing"});
+	EXPECT_EQ(2, keepLast.bulkLoad(items, 2, siddiqsoft::DuplicatePolicy::KeepLast));
+	EXPECT_EQ("last", keepLast.find("a")->name);
+	EXPECT_EQ("b", keepLast.find("b")->name);
+
+	// Fail leaves the container untouched whether the duplicate is in the batch or already present
+	siddiqsoft::RWLContainer<std::string, MyItem> fail;
+	EXPECT_THROW(fail.bulkLoad(items, 2, siddiqsoft::DuplicatePolicy::Fail), std::invalid_argument);
+	EXPECT_EQ(0, fail.size());
+	fail.add("b", {9, "existing"});
+	EXPECT_THROW(fail.bulkLoad(std::vector<std::pair<std::string, MyItem>> {{"a", {1, "a"}}, {"b", {2, "b"}}},
+	                           2,
+	                           siddiqsoft::DuplicatePolicy::Fail),
+	             std::invalid_argument);
+	EXPECT_EQ(1, fail.size());
+	EXPECT_EQ("existing", fail.find("b")->name);
+}
+
+
+TEST(RWContainer_index, FindBySecondaryIndex)
+{
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+	myContainer.ReplaceExisting = true;
+
+	myContainer.add("session1", {1, "alice@example.com"});
+	// Indexes registered after items exist are built from them
+	auto byEmail = myContainer.registerIndex([](const MyItem& item) { return item.name; }, true);
+	auto byFlag  = myContainer.registerIndex([](const MyItem& item) { return item.flag; });
+
+	myContainer.add("session2", {2, "bob@example.com"});
+	myContainer.add("session3", {2, "carol@example.com"});
+
+	ASSERT_TRUE(myContainer.findBy(byEmail, "bob@example.com"));
+	EXPECT_EQ(2, myContainer.findBy(byEmail, "bob@example.com")->flag);
+	EXPECT_EQ(1, myContainer.findBy(byEmail, "alice@example.com")->flag);
+	EXPECT_EQ(2, myContainer.findAllBy(byFlag, 2).size());
+	EXPECT_FALSE(myContainer.findBy(byEmail, "nobody@example.com"));
+
+	// Replace moves the entry in every index
+	myContainer.add("session2", {3, "bob@example.org"});
+	EXPECT_FALSE(myContainer.findBy(byEmail, "bob@example.com"));
+	EXPECT_EQ(3, myContainer.findBy(byEmail, "bob@example.org")->flag);
+	EXPECT_EQ(1, myContainer.findAllBy(byFlag, 2).size());
+	EXPECT_EQ(1, myContainer.findAllBy(byFlag, 3).size());
+
+	// Remove drops it
+	(void)myContainer.remove("session2");
+	EXPECT_FALSE(myContainer.findBy(byEmail, "bob@example.org"));
+	EXPECT_TRUE(myContainer.findAllBy(byFlag, 3).empty());
+}
+
+
+TEST(RWContainer_index, UniqueViolation)
+{
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+	myContainer.ReplaceExisting = true;
+
+	auto byEmail = myContainer.registerIndex([](const MyItem& item) { return item.name; }, true);
+	myContainer.add("session1", {1, "alice@example.com"});
+
+	// Another key may not take the value; the container and index are unchanged
+	EXPECT_THROW(myContainer.add("session2", {2, "alice@example.com"}), std::invalid_argument);
+	EXPECT_EQ(1, myContainer.size());
+	EXPECT_FALSE(myContainer.find("session2"));
+	EXPECT_EQ(1, myContainer.findBy(byEmail, "alice@example.com")->flag);
+
+	// The same key may keep it
+	myContainer.add("session1", {5, "alice@example.com"});
+	EXPECT_EQ(5, myContainer.findBy(byEmail, "alice@example.com")->flag);
+
+	// bulkLoad keeps the index in sync
+	std::vector<std::pair<std::string, MyItem>> items {{"session3", {3, "carol@example.com"}}, {"session1", {6, "alice@example.net"}}};
+	EXPECT_EQ(2, myContainer.bulkLoad(items, 1, siddiqsoft::DuplicatePolicy::KeepLast));
+	EXPECT_FALSE(myContainer.findBy(byEmail, "alice@example.com"));
+	EXPECT_EQ(6, myContainer.findBy(byEmail, "alice@example.net")->flag);
+	EXPECT_EQ(3, myContainer.findBy(byEmail, "carol@example.com")->flag);
+
+	// A second container rejects the handle of an index it does not have
+	siddiqsoft::RWLContainer<std::string, MyItem> other;
+	EXPECT_THROW((void)other.findBy(byEmail, "alice@example.net"), std::out_of_range);
+}
+
+
+TEST(RWContainer_column, ScanWhereMatchesScan)
+{
+	const int                                     ITEM_COUNT = 100000;
+	siddiqsoft::RWLContainer<std::string, MyItem> myContainer;
+	myContainer.ReplaceExisting = true;
+
+	for (auto i = 0; i < ITEM_COUNT / 2; i++)
+		myContainer.add(std::format("foo_{}", i), {i, "bar"});
+	auto byFlag = myContainer.registerColumn([](const MyItem& item) { return static_cast<int64_t>(item.flag); });
+	for (auto i = ITEM_COUNT / 2; i < ITEM_COUNT; i++)
+		myContainer.add(std::format("foo_{}", i), {i, "bar"});
+
+	// Replaced and removed items move in the column
+	for (auto i = 0; i < ITEM_COUNT; i += 10)
+		myContainer.add(std::format("foo_{}", i), {-i, "replaced"});
+	for (auto i = 5; i < ITEM_COUNT; i += 10)
+		(void)myContainer.remove(std::format("foo_{}", i));
+
+	auto selective = [](int64_t flag) { return (flag % 100) == 1; };
+
+	std::map<std::string, int> expected {};
+	auto                       start = std::chrono::steady_clock::now();
+	myContainer.scan([&](const std::string& key, const MyItemPtr& item) {
+		if (selective(item->flag)) expected[key] = item->flag;
+		return false;
+	});
+	auto scanTime = std::chrono::steady_clock::now() - start;
+
+	std::map<std::string, int> actual {};
+	start        = std::chrono::steady_clock::now();
+	auto matches = myContainer.scanWhere(byFlag, selective, [&](const std::string& key, const MyItemPtr& item) { actual[key] = item->flag; });
+	auto columnTime = std::chrono::steady_clock::now() - start;
+
+	std::cerr << std::format("scan: {}us  scanWhere: {}us\n",
+	                         std::chrono::duration_cast<std::chrono::microseconds>(scanTime).count(),
+	                         std::chrono::duration_cast<std::chrono::microseconds>(columnTime).count());
+
+	EXPECT_FALSE(expected.empty());
+	EXPECT_EQ(expected.size(), matches);
+	EXPECT_EQ(expected, actual);
+	EXPECT_EQ(ITEM_COUNT - ITEM_COUNT / 10,
+	          myContainer.scanWhere(byFlag, [](int64_t) { return true; }, [](const std::string&, const MyItemPtr&) {}));
+	EXPECT_EQ(0, myContainer.scanWhere(byFlag, [](int64_t flag) { return flag > ITEM_COUNT; }, [](const std::string&, const MyItemPtr&) {}));
+}
+
+
+TEST(RWContainer_export, JsonLinesKeys)
+{
+	siddiqsoft::RWLContainer<int, MyItem> myContainer;
+	myContainer.add(7, {7, "seven"});
+
+	// Binary keys cannot be represented in JSON
+	std::ostringstream out {};
+	EXPECT_THROW(myContainer.exportTo(siddiqsoft::ExportWriter::toStream(out),
+	                                  siddiqsoft::ExportFormat::JsonLines,
+	                                  siddiqsoft::JsonCodec<MyItem> {},
+	                                  siddiqsoft::PodCodec<int> {}),
+	             std::invalid_argument);
+	EXPECT_TRUE(out.str().empty());
+
+	// A JSON key codec writes the key as a JSON value
+	EXPECT_EQ(1,
+	          myContainer.exportTo(siddiqsoft::ExportWriter::toStream(out),
+	                               siddiqsoft::ExportFormat::JsonLines,
+	                               siddiqsoft::JsonCodec<MyItem> {},
+	                               siddiqsoft::JsonCodec<int> {}));
+	auto doc = nlohmann::json::parse(out.str());
+	EXPECT_EQ(7, doc["key"].get<int>());
+	EXPECT_EQ("seven", doc["value"]["name"].get<std::string>());
+
+	// Binary is unaffected
+	EXPECT_EQ(1, myContainer.exportTo([](std::string_view) {}, siddiqsoft::ExportFormat::Binary, MyItemCodec {}, siddiqsoft::PodCodec<int> {}));
+}